@@ -0,0 +1,408 @@
+/* Resident UART bootloader, the first 2 KB page of flash
+ *
+ * Starts the application at APP_BASE when its app_info_t checks out and no
+ * update was requested, without touching the clocks or the RAM the
+ * application keeps over a reset. Otherwise it stays, debug LED on, and
+ * takes an image over USART1, and USART2 when the request asks for it, in
+ * the protocol of include/bootloader.h. Both USARTs receive by circular
+ * DMA, so the next blocks keep arriving while one is programmed: flash
+ * stalls the core, not the DMA.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bootloader.h"
+#include "flash.h"
+#include "gpio.h"
+#include "pins.h"
+#include "stm32c011xx.h"
+
+#define CLOCK_HZ        48000000UL  /* HSI48 undivided, 1 wait state */
+#define RING_SIZE       2048U       /* A power of 2 above BL_WINDOW full DATA frames */
+#define FRAME_HEAD      6U          /* SOF type seq len */
+#define FRAME_MAX       (FRAME_HEAD - 1U + BL_BLOCK + 4U)
+#define BAUD_MIN        9600U
+
+/* DMAMUX request inputs (RM0490) */
+#define DMAREQ_USART1_RX    50U
+#define DMAREQ_USART2_RX    52U
+
+/* The debug LED and both USARTs are on GPIOA pins 0-7 (pins.h), set up from
+   the registers' reset values: alternate function, pull-up on RX */
+#define GPIO_FIELD(pin, v)  ((uint32_t)(v) << ((pin) * 2U))
+#define UART_PINS(tx, rx, af) do { \
+        GPIOA->MODER = (GPIOA->MODER & ~(GPIO_FIELD(tx, 3U) | GPIO_FIELD(rx, 3U))) | \
+                       GPIO_FIELD(tx, 2U) | GPIO_FIELD(rx, 2U); \
+        GPIOA->PUPDR |= GPIO_FIELD(rx, 1U); \
+        GPIOA->AFR[0] |= (uint32_t)(af) << ((tx) * 4U) | (uint32_t)(af) << ((rx) * 4U); \
+    } while (0)
+
+extern uint32_t _estack, _sidata, _sdata, _edata, _sbss, _ebss;
+
+void Reset_Handler(void);
+void Fault_Handler(void);
+
+typedef void (*vector_t)(void);
+
+/* No interrupts are enabled: the reset and fault vectors are enough */
+__attribute__((section(".isr_vector"), used))
+static const vector_t vectors[] = {
+    (vector_t)&_estack,
+    Reset_Handler,
+    Fault_Handler,      /* NMI */
+    Fault_Handler,      /* HardFault */
+};
+
+typedef struct {
+    USART_TypeDef *usart;
+    DMA_Channel_TypeDef *dma;
+    uint16_t tail;
+    uint8_t ring[RING_SIZE];
+} port_t;
+
+static port_t ports[2];
+static port_t *host;            /* Port of the first valid frame, the only one after */
+
+/* type seq len payload crc of the frame being handled, SOF stripped */
+static uint8_t frame[FRAME_MAX] __attribute__((aligned(4)));
+
+static struct {
+    uint32_t length;            /* Of the image since START, 0 before */
+    uint32_t crc;
+    uint32_t next;              /* Offset the next DATA must have */
+    uint16_t last_seq;          /* Of the last DATA */
+    bool nak_sent;              /* For next, until the host goes back */
+    bool done;                  /* END accepted, app_info_t written */
+} image;
+
+static uint32_t rd32(const uint8_t *p) {
+    return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void wr32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+/* CRC-32 as zlib computes it, on the CRC unit with its reset polynomial
+   and initial value. Words go in bit-reversed by word, the tail bytes by
+   byte; p must be word aligned. */
+static uint32_t crc32(const uint8_t *p, uint32_t len) {
+    CRC->CR = CRC_CR_REV_OUT | CRC_CR_REV_IN_0 | CRC_CR_REV_IN_1 | CRC_CR_RESET;
+    for (; len >= 4U; len -= 4U, p += 4)
+        CRC->DR = *(const uint32_t *)p;
+    CRC->CR = CRC_CR_REV_OUT | CRC_CR_REV_IN_0;
+    for (; len; len--)
+        *(volatile uint8_t *)&CRC->DR = *p++;
+    return ~CRC->DR;
+}
+
+/* HSI48 undivided, for the image CRC and the baud rates: the wait state
+   first. clock_reset() returns to the reset state (HSI48 / 4, no wait
+   state) the application starts from. */
+static void clock_fast(void) {
+    FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | (1U << FLASH_ACR_LATENCY_Pos);
+    while ((FLASH->ACR & FLASH_ACR_LATENCY) != (1U << FLASH_ACR_LATENCY_Pos));
+    RCC->CR &= ~RCC_CR_HSIDIV;
+}
+
+static void clock_reset(void) {
+    RCC->CR = (RCC->CR & ~RCC_CR_HSIDIV) | (2U << RCC_CR_HSIDIV_Pos);
+    FLASH->ACR &= ~FLASH_ACR_LATENCY;
+    while (FLASH->ACR & FLASH_ACR_LATENCY);
+}
+
+/* Only the info->length bytes of the image are read, at 48 MHz */
+static bool app_valid(void) {
+    const app_info_t *info = (const app_info_t *)APP_INFO;
+    const uint32_t *app = (const uint32_t *)APP_BASE;
+
+    if (info->magic != APP_INFO_MAGIC || info->length < 8U ||
+        info->length > APP_IMAGE_MAX || (info->length & 7U)) return false;
+    /* Reset vector inside the image */
+    if (app[1] < APP_BASE || app[1] >= APP_BASE + info->length) return false;
+    return crc32((const uint8_t *)APP_BASE, info->length) == info->crc;
+}
+
+static void start_app(void) {
+    const uint32_t *app = (const uint32_t *)APP_BASE;
+
+    RCC->AHBENR &= ~RCC_AHBENR_CRCEN;
+    clock_reset();
+    SCB->VTOR = APP_BASE;
+    __asm volatile ("msr msp, %0\n\tbx %1" : : "r" (app[0]), "r" (app[1]));
+    __builtin_unreachable();
+}
+
+/* ---- USART with circular DMA reception ---- */
+
+static void port_init(port_t *p, USART_TypeDef *usart, DMA_Channel_TypeDef *dma,
+                      DMAMUX_Channel_TypeDef *mux, uint32_t request) {
+    p->usart = usart;
+    p->dma = dma;
+    mux->CCR = request << DMAMUX_CxCR_DMAREQ_ID_Pos;
+    dma->CPAR = (uint32_t)&usart->RDR;
+    dma->CMAR = (uint32_t)p->ring;
+    dma->CNDTR = RING_SIZE;
+    dma->CCR = DMA_CCR_MINC | DMA_CCR_CIRC | DMA_CCR_EN;
+    usart->BRR = CLOCK_HZ / BL_BAUD_DEFAULT;
+    /* An overrun would stop the DMA; the frame CRC catches the lost byte */
+    usart->CR3 = USART_CR3_DMAR | USART_CR3_OVRDIS;
+    usart->CR1 = USART_CR1_TE | USART_CR1_RE | USART_CR1_UE;
+}
+
+/* The DMA writes at RING_SIZE - CNDTR */
+static uint16_t ring_avail(const port_t *p) {
+    return (uint16_t)((RING_SIZE - p->dma->CNDTR - p->tail) & (RING_SIZE - 1U));
+}
+
+static uint8_t ring_peek(const port_t *p, uint16_t i) {
+    return p->ring[(p->tail + i) & (RING_SIZE - 1U)];
+}
+
+static void ring_drop(port_t *p, uint16_t n) {
+    p->tail = (uint16_t)((p->tail + n) & (RING_SIZE - 1U));
+}
+
+static void send(USART_TypeDef *usart, const uint8_t *data, uint16_t len) {
+    while (len--) {
+        while (!(usart->ISR & USART_ISR_TXE_TXFNF));
+        usart->TDR = *data++;
+    }
+}
+
+static void reply(uint8_t type, uint16_t seq, const uint8_t *data, uint8_t len) {
+    static const uint8_t sof = BL_SOF;
+    uint8_t out[5 + 12 + 4] __attribute__((aligned(4)));
+
+    out[0] = type;
+    out[1] = (uint8_t)seq;
+    out[2] = (uint8_t)(seq >> 8);
+    out[3] = len;
+    out[4] = 0;
+    for (uint8_t i = 0; i < len; i++) out[5 + i] = data[i];
+    wr32(out + 5 + len, crc32(out, 5U + len));
+    send(host->usart, &sof, 1);
+    send(host->usart, out, 5U + len + 4U);
+}
+
+static void nak(uint8_t type, uint16_t seq, uint8_t err) {
+    reply(BL_NAK | type, seq, &err, 1);
+}
+
+/* The DATA expected next was lost: ask for it once, the host goes back */
+static void nak_next(uint8_t err) {
+    if (image.length == 0U || image.done || image.nak_sent) return;
+    image.nak_sent = true;
+    nak(BL_DATA, (uint16_t)(image.next / BL_BLOCK), err);
+}
+
+/* Takes the next frame off the ring into frame[]: its payload length, or -1
+   while none is complete. Bytes before a SOF are skipped; after a bad CRC
+   the search starts again one byte on. */
+static int frame_poll(port_t *p) {
+    for (;;) {
+        uint16_t n = ring_avail(p);
+        while (n && ring_peek(p, 0) != BL_SOF) {
+            ring_drop(p, 1);
+            n--;
+        }
+        if (n < FRAME_HEAD) return -1;
+
+        uint16_t len = ring_peek(p, 4) | (uint16_t)ring_peek(p, 5) << 8;
+        if (len > BL_BLOCK) {
+            ring_drop(p, 1);
+            continue;
+        }
+        if (n < FRAME_HEAD + len + 4U) return -1;
+
+        for (uint16_t i = 0; i < FRAME_HEAD - 1U + len + 4U; i++)
+            frame[i] = ring_peek(p, i + 1U);
+        if (crc32(frame, 5U + len) == rd32(frame + 5 + len)) {
+            ring_drop(p, FRAME_HEAD + len + 4U);
+            return len;
+        }
+        ring_drop(p, 1);
+        if (p == host) nak_next(BL_ERR_FRAME);
+    }
+}
+
+/* ---- Requests: each returns 0 for an ACK, a BL_ERR_ code or NO_REPLY ---- */
+
+#define NO_REPLY        0xFFU
+#define LE32(v)         (uint8_t)(v), (uint8_t)((v) >> 8), (uint8_t)((v) >> 16), (uint8_t)((v) >> 24)
+
+static const uint8_t hello[12] = {
+    BL_VERSION, BL_WINDOW, (uint8_t)BL_BLOCK, (uint8_t)(BL_BLOCK >> 8), LE32(APP_BASE), LE32(APP_IMAGE_MAX)
+};
+
+/* The ACK goes out at the old rate */
+static uint8_t on_baud(uint16_t seq, const uint8_t *data, uint16_t len) {
+    USART_TypeDef *usart = host->usart;
+    uint32_t baud = len == 4U ? rd32(data) : 0U;
+    uint32_t brr = 0;
+
+    if (baud < BAUD_MIN || baud > CLOCK_HZ / 16U) return BL_ERR_RANGE;
+    /* CLOCK_HZ / baud, rounded, without a library divide */
+    for (uint32_t r = CLOCK_HZ + baud / 2U; r >= baud; r -= baud) brr++;
+    reply(BL_ACK | BL_BAUD, seq, 0, 0);
+    while (!(usart->ISR & USART_ISR_TC));
+    usart->CR1 &= ~USART_CR1_UE;
+    usart->BRR = brr;
+    usart->CR1 |= USART_CR1_UE;
+    return NO_REPLY;
+}
+
+static uint8_t on_start(const uint8_t *data, uint16_t len) {
+    uint32_t length = len == 8U ? rd32(data) : 0U;
+
+    if (length == 0U || length > APP_IMAGE_MAX || (length & 7U)) return BL_ERR_RANGE;
+    /* Without its record the old image no longer starts */
+    image.length = 0;
+    Flash_Unlock();
+    if (Flash_ErasePage((const void *)APP_INFO) != 0) return BL_ERR_FLASH;
+    image.length = length;
+    image.crc = rd32(data + 4);
+    image.next = 0;
+    image.last_seq = 0;
+    image.nak_sent = false;
+    image.done = false;
+    return 0;
+}
+
+/* DATA comes in order, so a page is erased when its first double word is due */
+static uint8_t on_data(uint16_t seq, const uint8_t *data, uint16_t len) {
+    uint32_t offset = (uint32_t)seq * BL_BLOCK;
+
+    if (seq <= image.last_seq) image.nak_sent = false;     /* A resend */
+    image.last_seq = seq;
+
+    if (image.length == 0U || image.done) return BL_ERR_STATE;
+    if (offset < image.next) return 0;                      /* Its ACK was lost */
+    if (offset > image.next) {
+        nak_next(BL_ERR_SEQ);
+        return NO_REPLY;
+    }
+    if (len == 0U || (len & 7U) || offset + len > image.length ||
+        (len != BL_BLOCK && offset + len != image.length)) return BL_ERR_RANGE;
+
+    for (uint16_t i = 0; i < len; i += 8U) {
+        uint32_t addr = APP_BASE + offset + i;
+        if ((addr & (FLASH_EMU_PAGE_SIZE - 1U)) == 0U && Flash_ErasePage((const void *)addr) != 0)
+            return BL_ERR_FLASH;
+        if (Flash_ProgramDoubleWord((const void *)addr, rd32(data + i), rd32(data + i + 4)) != 0)
+            return BL_ERR_FLASH;
+    }
+    image.next += len;
+    image.nak_sent = false;
+    PIN_TOGGLE(LED);
+    return 0;
+}
+
+/* The record gets the CRC from START; app_valid() checks it against the
+   flash, as on every reset. A failure takes a new START. */
+static uint8_t on_end(void) {
+    if (image.done) return 0;
+    if (image.length == 0U || image.next != image.length) return BL_ERR_STATE;
+
+    uint8_t err = 0;
+    if (Flash_ProgramDoubleWord((const void *)APP_INFO, APP_INFO_MAGIC, image.length) != 0 ||
+        Flash_ProgramDoubleWord((const void *)(APP_INFO + 8U), image.crc, 0xFFFFFFFFUL) != 0)
+        err = BL_ERR_FLASH;
+    else if (!app_valid())
+        err = BL_ERR_CRC;
+    Flash_Lock();
+    if (err) image.length = 0;
+    image.done = !err;
+    return err;
+}
+
+static void handle(uint16_t len) {
+    uint8_t type = frame[0];
+    uint16_t seq = frame[1] | (uint16_t)frame[2] << 8;
+    const uint8_t *data = frame + 5;
+    uint8_t err;
+
+    switch (type) {
+    case BL_HELLO:
+        reply(BL_ACK | BL_HELLO, seq, hello, sizeof(hello));
+        return;
+    case BL_BAUD:
+        err = on_baud(seq, data, len);
+        break;
+    case BL_START:
+        err = on_start(data, len);
+        break;
+    case BL_DATA:
+        err = on_data(seq, data, len);
+        break;
+    case BL_END:
+        err = on_end();
+        break;
+    case BL_RUN:
+        err = app_valid() ? 0 : BL_ERR_STATE;
+        break;
+    default:
+        return;
+    }
+    if (err == NO_REPLY) return;
+    if (err) {
+        nak(type, seq, err);
+        return;
+    }
+    reply(BL_ACK | type, seq, 0, 0);
+    if (type == BL_RUN) {
+        while (!(host->usart->ISR & USART_ISR_TC));
+        NVIC_SystemReset();
+    }
+}
+
+static void update(uint32_t flags) {
+    RCC->IOPENR |= RCC_IOPENR_GPIOAEN;
+    GPIOA->MODER = (GPIOA->MODER & ~GPIO_FIELD(LED_GPIO_PIN, 3U)) | GPIO_FIELD(LED_GPIO_PIN, 1U);
+    PIN_SET(LED);
+
+    RCC->AHBENR |= RCC_AHBENR_DMA1EN;
+    RCC->APBENR2 |= RCC_APBENR2_USART1EN;
+    UART_PINS(UART_TX_GPIO_PIN, UART_RX_GPIO_PIN, UART_TX_AF);
+    port_init(&ports[0], USART1, DMA1_Channel1, DMAMUX1_Channel0, DMAREQ_USART1_RX);
+    if (flags & BOOT_REQUEST_UART2) {
+        RCC->APBENR1 |= RCC_APBENR1_USART2EN;
+        UART_PINS(SAO_UART_TX_GPIO_PIN, SAO_UART_RX_GPIO_PIN, SAO_UART_TX_AF);
+        port_init(&ports[1], USART2, DMA1_Channel2, DMAMUX1_Channel1, DMAREQ_USART2_RX);
+    }
+
+    for (;;) {
+        for (uint8_t i = 0; i < 2U; i++) {
+            port_t *p = &ports[i];
+            if (p->usart == 0 || (host != 0 && p != host)) continue;
+            int len = frame_poll(p);
+            if (len < 0) continue;
+            host = p;
+            handle((uint16_t)len);
+        }
+    }
+}
+
+void Reset_Handler(void) {
+    /* Only the stack until the decision: .noinit of the application stays */
+    uint32_t magic = BOOT_REQUEST->magic;
+    uint32_t flags = BOOT_REQUEST->flags;
+    BOOT_REQUEST->magic = 0;
+
+    clock_fast();           /* Also the 48 MHz update() runs at */
+    RCC->AHBENR |= RCC_AHBENR_CRCEN;
+    if (magic != BOOT_REQUEST_MAGIC && app_valid()) start_app();
+
+    for (uint32_t *src = &_sidata, *dst = &_sdata; dst < &_edata;) *dst++ = *src++;
+    for (uint32_t *dst = &_sbss; dst < &_ebss;) *dst++ = 0;
+
+    /* Without a request nothing says which port: listen on both */
+    update(magic == BOOT_REQUEST_MAGIC ? flags : BOOT_REQUEST_UART2);
+}
+
+void Fault_Handler(void) {
+    NVIC_SystemReset();
+}
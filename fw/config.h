@@ -5,10 +5,32 @@
 
 /* Feature flags */
 #define ENABLE_HAMQUEST 1  /* Disable hamquest to save memory */
+#define ENABLE_GPIO_BENCH 0  /* 'bench' CLI command: cycle counts of the LED pin paths */
+#ifndef ENABLE_RAMFUNC
+#define ENABLE_RAMFUNC 1     /* Hot ISR paths run from SRAM; 'make RAMFUNC=0' keeps them in flash */
+#endif
+
+/* Functions marked RAMFUNC are linked into .ramfunc, which the startup code
+   copies to SRAM with .data: no flash wait state at 48 MHz */
+#if ENABLE_RAMFUNC && !defined(BOARD_SIM)
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+/* Variables marked NOINIT go to .noinit, which the startup code neither
+   loads nor clears: they keep their contents over a soft reset and hold
+   garbage after power-on, so they need a validity check */
+#ifndef BOARD_SIM
+#define NOINIT __attribute__((section(".noinit")))
+#else
+#define NOINIT
+#endif
 
 /* Clock Configuration */
 #define HSI_VALUE           12000000U   /* HSI oscillator frequency */
-#define SYSTEM_CLOCK_HZ     12000000U   /* Target system clock: 12 MHz */
+#define SYSTEM_CLOCK_HZ     12000000U   /* Boot clock (CLOCK_ECO): HSI48 / 4 */
+#define SYSTEM_CLOCK_PERF_HZ 48000000U  /* CLOCK_PERF: HSI48 undivided, 1 flash wait state */
 
 /* UART Configuration */
 #define UART_BAUDRATE       115200U
@@ -20,6 +42,13 @@
 /* TODO: Define TIMER_PERIPHERAL after CMSIS is available */
 #define DELAY_TIMER_FREQ_HZ 1000000U    /* 1 MHz for microsecond delays */
 
+/* Config storage backend. AUTO uses the 24C02 when it answers on I2C and falls
+   back to EEPROM emulation in the last two flash pages otherwise. */
+#define STORAGE_BACKEND_AUTO    0
+#define STORAGE_BACKEND_EEPROM  1
+#define STORAGE_BACKEND_FLASH   2
+#define STORAGE_BACKEND     STORAGE_BACKEND_AUTO
+
 /* Buffer Sizes */
 #define UART_TX_BUFFER_SIZE 128         /* Smaller buffers for limited RAM */
 #define UART_RX_BUFFER_SIZE 128
@@ -0,0 +1,31 @@
+#ifndef BCM_H
+#define BCM_H
+
+#include <stdint.h>
+
+/* Binary code modulation (bit-angle modulation) brightness for LED1..LED5.
+   A frame is BCM_PLANES bit planes, plane k lasting BCM_BASE_US << k, so an
+   LED is lit for level * BCM_BASE_US per frame (255 * 16 us = 4.08 ms, 245 Hz). */
+#define BCM_LEDS        5
+#define BCM_PLANES      8
+#define BCM_BASE_US     16U
+
+/* Brightness 0..255 per LED (led 0 = LED1). New levels take effect at the
+   next frame start; all-on/off frames are written at once and stop the timer. */
+void BCM_SetLevel(uint8_t led, uint8_t level);
+void BCM_SetLevels(const uint8_t *levels);
+uint8_t BCM_GetLevel(uint8_t led);
+/* Brightness scale 0..255 for all levels (255 = as set); applied to the
+   current levels at once. Scaled full-on LEDs need the timer. */
+void BCM_SetScale(uint8_t scale);
+
+/* Timer interrupt at the start of each bit plane: outputs the plane and
+   returns the length of the plane after it in us */
+uint16_t BCM_NextPlane(void);
+
+/* Plane timer, provided by the timer driver: runs for first_us, then for
+   next_us, then for each length returned by BCM_NextPlane() */
+void BCM_TimerStart(uint16_t first_us, uint16_t next_us);
+void BCM_TimerStop(void);
+
+#endif /* BCM_H */
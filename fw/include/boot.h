@@ -0,0 +1,33 @@
+#ifndef BOOT_H
+#define BOOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Boot phases
+ *
+ * main() marks the end of each phase with its micros() time; the time
+ * base starts in Timer_Init(), the first thing after the startup code and
+ * fault_init(). 'boot' prints the table. With fast boot (a flag in the
+ * boot settings, 'boot fast on') the LED engine starts before the rest of
+ * the configuration is loaded and the banner follows from the main loop.
+ */
+typedef enum {
+    BOOT_SYSTEM,        /* System_Init() */
+    BOOT_UART,
+    BOOT_LED,           /* Debug LED and LED1..5 pins */
+    BOOT_I2C,           /* eeprom_init() */
+    BOOT_SETTINGS,      /* Storage, boot mode and flags: CLI_Init() */
+    BOOT_CONFIG,        /* The rest: CLI_LoadConfig() */
+    BOOT_LEDS_ON,       /* First pattern_tick() */
+    BOOT_READY,         /* Prompt sent */
+    BOOT_PHASES
+} boot_phase_t;
+
+/* The first time only; later calls leave the phase as it was */
+void boot_mark(boot_phase_t phase);
+/* End of a phase in us; false when it has not been reached */
+bool boot_time(boot_phase_t phase, uint32_t *t_us);
+const char *boot_phase_name(boot_phase_t phase);
+
+#endif /* BOOT_H */
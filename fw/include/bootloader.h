@@ -0,0 +1,76 @@
+#ifndef BOOTLOADER_H
+#define BOOTLOADER_H
+
+#include <stdint.h>
+
+/* UART bootloader (bootloader/bootloader.c), shared with the application
+ *
+ * Flash layout, see STM32C011F6P6.ld and bootloader/bootloader.ld:
+ *   0x08000000  bootloader, one 2 KB page
+ *   0x08000800  application, up to APP_IMAGE_MAX bytes
+ *   0x08006FF0  app_info_t of the application, written by the bootloader
+ *   0x08007000  flash-emulated EEPROM (src/storage.c), never touched
+ */
+#define BOOTLOADER_BASE     0x08000000UL
+#define BOOTLOADER_SIZE     0x800UL
+#define APP_BASE            (BOOTLOADER_BASE + BOOTLOADER_SIZE)
+#define APP_INFO            0x08006FF0UL
+#define APP_IMAGE_MAX       (APP_INFO - APP_BASE)
+
+#define APP_INFO_MAGIC      0x4F464E49UL    /* "INFO" */
+
+typedef struct {
+    uint32_t magic;         /* APP_INFO_MAGIC */
+    uint32_t length;        /* Image bytes from APP_BASE, a multiple of 8 */
+    uint32_t crc;           /* CRC-32 (zlib) of those bytes */
+    uint32_t reserved;
+} app_info_t;
+
+/* Request from the application, in the top 8 bytes of SRAM that neither
+   stack uses. The bootloader clears it on reading. */
+#define BOOT_REQUEST_MAGIC  0x21554644UL    /* "DFU!" */
+#define BOOT_REQUEST_UART2  0x01U           /* Listen on the SAO USART2 too */
+
+typedef struct {
+    uint32_t magic;
+    uint32_t flags;
+} boot_request_t;
+
+#define BOOT_REQUEST        ((volatile boot_request_t *)(0x20000000UL + 6UL * 1024UL - 8UL))
+
+/* Update protocol, tools/fwupdate.py. Both directions use the same frame:
+ *
+ *   0xA5 type seq(16) len(16) payload[len] crc(32)
+ *
+ * little endian, the CRC-32 (zlib) over type..payload. A reply has the
+ * type of the request with BL_ACK or BL_NAK set and the request's seq; a
+ * NAK carries one BL_ERR_ byte, for DATA the seq expected next.
+ */
+#define BL_SOF              0xA5U
+#define BL_VERSION          1U
+#define BL_BLOCK            256U    /* Largest DATA payload */
+#define BL_WINDOW           7U      /* DATA frames in flight, covers USB serial latency */
+#define BL_BAUD_DEFAULT     115200U
+
+enum {
+    BL_HELLO = 1,           /* -> version, window, block(16), base(32), max(32) */
+    BL_BAUD,                /* baud(32); the ACK goes out at the old rate */
+    BL_START,               /* length(32) crc(32) */
+    BL_DATA,                /* seq = offset / BL_BLOCK, len a multiple of 8 */
+    BL_END,                 /* Checks the image CRC and writes app_info_t */
+    BL_RUN,                 /* Resets into the new application */
+};
+
+#define BL_ACK              0x80U
+#define BL_NAK              0x40U
+
+enum {
+    BL_ERR_FRAME = 1,       /* Bad frame CRC */
+    BL_ERR_SEQ,             /* DATA out of order */
+    BL_ERR_RANGE,           /* Length, offset or baud rate out of range */
+    BL_ERR_FLASH,           /* Erase or program failed */
+    BL_ERR_CRC,             /* Image CRC mismatch at END */
+    BL_ERR_STATE,           /* DATA, END or RUN without a complete image */
+};
+
+#endif /* BOOTLOADER_H */
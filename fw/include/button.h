@@ -0,0 +1,37 @@
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Button debouncer and gestures
+ *
+ * The EXTI interrupt only counts edges. The 1 ms system tick accepts a new
+ * level once the pin has been quiet for BUTTON_SETTLE_MS, runs the gesture
+ * state machine and posts each gesture as an EVENT_BUTTON (event.h), with
+ * the time of the press that started it, or of the repeat for BUTTON_HOLD.
+ * Nothing on this path waits. A short press is reported once the double
+ * click window has passed without a second press.
+ */
+#define BUTTON_SETTLE_MS    20U     /* Quiet time before a level is accepted */
+#define BUTTON_DOUBLE_MS    300U    /* Release to second press for a double click */
+#define BUTTON_LONG_MS      600U    /* Held at least this long: long press */
+#define BUTTON_HOLD_MS      1500U   /* Still held: hold-repeat from here on */
+#define BUTTON_REPEAT_MS    500U
+
+/* EVENT_BUTTON source; the data is the repeat number for BUTTON_HOLD, else 1 */
+typedef enum {
+    BUTTON_SHORT,
+    BUTTON_DOUBLE,
+    BUTTON_LONG,        /* Released after BUTTON_LONG_MS, before BUTTON_HOLD_MS */
+    BUTTON_HOLD,        /* Held: count 1 at BUTTON_HOLD_MS, then every BUTTON_REPEAT_MS */
+} button_gesture_t;
+
+/* Enable the EXTI interrupt on both edges; the pin is already an input */
+void button_init(void);
+/* From the EXTI interrupt */
+void button_edge(void);
+/* From the 1 ms system tick */
+void button_tick(uint32_t now_ms);
+
+#endif /* BUTTON_H */
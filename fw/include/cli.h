@@ -4,8 +4,14 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-/* CLI initialization */
+/* CLI initialization: storage and the boot settings (CW speed, boot mode,
+   boot flags), read in one go */
 void CLI_Init(void);
+/* The rest of the configuration; writes the defaults when the EEPROM
+   holds no valid image */
+void CLI_LoadConfig(void);
+/* Fast boot flag of the boot settings */
+bool CLI_FastBoot(void);
 
 /* CLI input processing */
 void CLI_ProcessChar(char c);
@@ -16,9 +22,16 @@ void CLI_PrintPrompt(void);
 /* Set boot time for uptime tracking */
 void CLI_SetBootTime(void);
 
+/* Save the current auto-blink mode as the boot default */
+void CLI_SaveMode(void);
+
 /* Show boot messages */
 void CLI_ShowBootMessages(bool with_delays);
-/* Expose CW buffer for LED blink mode */
-extern char current_cw[21];
+
+/* Fast boot: send the boot messages and then the prompt from the main loop,
+   as far as they fit in budget_us of UART time per call. Returns the time
+   spent, 0 when nothing was sent. */
+void CLI_QueueBootMessages(void);
+uint32_t CLI_DrainBootMessages(uint32_t budget_us);
 
 #endif /* CLI_H */
@@ -0,0 +1,32 @@
+#ifndef CWKEY_H
+#define CWKEY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Straight-key Morse decoder on the button
+ *
+ * While active the button is a straight key. The EXTI interrupt timestamps
+ * every press and release with micros() and queues the debounced edges;
+ * cwkey_tick() in the main loop measures marks and spaces against an
+ * adaptive dit estimate, decodes characters into a text buffer and echoes
+ * them on the UART. Nothing on this path waits.
+ */
+#define CWKEY_TEXT_MAX      20      /* Decoded text kept, the latest characters */
+#define CWKEY_DEBOUNCE_US   5000U   /* Edges closer than this to the last one are bounce */
+
+void cwkey_start(void);
+void cwkey_stop(void);
+bool cwkey_active(void);
+
+/* From the button EXTI interrupt */
+void cwkey_edge(bool down, uint32_t t_us);
+/* From the main loop */
+void cwkey_tick(uint32_t now_us);
+
+const char *cwkey_text(void);
+void cwkey_clear(void);
+/* Speed estimate from the keyed dits and dahs (PARIS) */
+uint8_t cwkey_wpm(void);
+
+#endif /* CWKEY_H */
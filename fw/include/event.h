@@ -0,0 +1,41 @@
+#ifndef EVENT_H
+#define EVENT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Interrupt to main loop event queue
+ *
+ * Interrupt handlers post events, the main loop takes them in order and
+ * sleeps in event_wait() while the queue is empty. Any handler may post:
+ * the insert runs with interrupts masked for a few instructions, the main
+ * loop is the only consumer and takes events without masking anything.
+ */
+#define EVENT_QUEUE         8       /* Entries, one stays free */
+
+typedef enum {
+    EVENT_BUTTON,       /* source: button_gesture_t, data: repeat count */
+    EVENT_UART_RX,      /* source: 1 or 2 for USART1/USART2; RX ring no longer empty */
+    EVENT_TIMER,        /* source: EVENT_SRC_WAKE, the wake timer expired */
+    EVENT_POWER,        /* source: BADGE_PWR_SENSE level after the first edge of a burst */
+} event_type_t;
+
+#define EVENT_SRC_WAKE      16U     /* TIM16 */
+
+typedef struct {
+    uint8_t type;       /* event_type_t */
+    uint8_t source;
+    uint16_t data;
+    uint32_t t_us;      /* When it happened, on the micros() clock */
+} event_t;
+
+/* From any context. Returns -1 when the queue is full and the event is lost */
+int event_post(uint8_t type, uint8_t source, uint16_t data, uint32_t t_us);
+
+/* Main loop: next event, false when there is none */
+bool event_get(event_t *ev);
+bool event_pending(void);
+/* Main loop: sleep until at least one event is queued */
+void event_wait(void);
+
+#endif /* EVENT_H */
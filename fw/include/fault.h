@@ -0,0 +1,45 @@
+#ifndef FAULT_H
+#define FAULT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Post-mortem record
+ *
+ * The HardFault handler copies the exception frame, the stack pointer and
+ * a few words of the stack above the frame into a .noinit record, then
+ * resets. The record, the boot counter and the fault counter survive soft
+ * resets and start over at power-on; 'dmesg' shows them.
+ */
+#define FAULT_STACK_WORDS   8
+
+/* Reset flags of the current boot: RCC_CSR2 bits 31..24 */
+#define FAULT_RESET_OPTION      0x02U   /* Option byte load */
+#define FAULT_RESET_PIN         0x04U   /* NRST, also set by every internal reset */
+#define FAULT_RESET_POWER       0x08U   /* Power-on or brown-out */
+#define FAULT_RESET_SOFTWARE    0x10U   /* reboot, or after a fault */
+#define FAULT_RESET_IWDG        0x20U
+#define FAULT_RESET_WWDG        0x40U
+#define FAULT_RESET_LOWPOWER    0x80U
+
+typedef struct {
+    uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;     /* Stacked on exception entry */
+    uint32_t sp;            /* Before the exception */
+    uint32_t exc_return;    /* LR in the handler: 0xFFFFFFF9 thread mode on MSP */
+    uint32_t stack[FAULT_STACK_WORDS];  /* Above the frame, 0 outside SRAM */
+    uint32_t boot;          /* fault_boots() of the run that faulted */
+} fault_record_t;
+
+/* At boot, before anything else that can fault: counts the boot, reads and
+   clears the reset flags */
+void fault_init(void);
+
+uint32_t fault_boots(void);     /* Since power-on, this one included */
+uint32_t fault_count(void);     /* HardFaults since power-on */
+uint8_t fault_reset_flags(void);
+/* The most telling of the reset flags */
+const char *fault_reset_cause(void);
+/* The last fault since power-on, NULL when there was none */
+const fault_record_t *fault_last(void);
+
+#endif /* FAULT_H */
@@ -0,0 +1,19 @@
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+
+/* STM32C011 flash geometry: 2 KB pages, 64-bit programming granularity */
+#define FLASH_EMU_PAGE_SIZE     2048U
+#define FLASH_EMU_PAGES         2U      /* Last two pages, reserved in STM32C011F6P6.ld */
+
+/* Start of the reserved EEPROM emulation region (linker symbol) */
+extern uint8_t _fee_start[];
+
+/* Flash programming functions (blocking, run from flash; the core stalls on access) */
+void Flash_Unlock(void);
+void Flash_Lock(void);
+int Flash_ErasePage(const void *page);
+int Flash_ProgramDoubleWord(const void *addr, uint32_t lo, uint32_t hi);
+
+#endif /* FLASH_H */
@@ -2,6 +2,7 @@
 #define GPIO_H
 
 #include <stdint.h>
+#include "stm32c011xx.h"    /* GPIOx port handles used by pins.h */
 
 /* GPIO Mode */
 typedef enum {
@@ -32,6 +33,13 @@ typedef enum {
     GPIO_PUPD_PD   = 2   /* Pull-down */
 } GPIO_PuPd_t;
 
+/* GPIO EXTI trigger edge */
+typedef enum {
+    GPIO_EDGE_FALLING = 1,
+    GPIO_EDGE_RISING  = 2,
+    GPIO_EDGE_BOTH    = 3
+} GPIO_Edge_t;
+
 /* GPIO functions */
 void GPIO_ClockEnable(void *port);
 void GPIO_SetMode(void *port, uint8_t pin, GPIO_Mode_t mode);
@@ -43,5 +51,68 @@ void GPIO_SetPin(void *port, uint8_t pin);
 void GPIO_ClearPin(void *port, uint8_t pin);
 void GPIO_TogglePin(void *port, uint8_t pin);
 uint8_t GPIO_ReadPin(void *port, uint8_t pin);
+/* Set pins in bits 0..15 and reset pins in bits 16..31 with one store */
+void GPIO_WriteBSRR(void *port, uint32_t bsrr);
+
+/* Route pin to its EXTI line and enable the interrupt on the given edge(s) */
+void GPIO_EnableIRQ(void *port, uint8_t pin, GPIO_Edge_t edge);
+/* Called from EXTI interrupt context; weak default does nothing */
+void GPIO_EXTI_Callback(uint8_t pin, GPIO_Edge_t edge);
+
+/* With ENABLE_GPIO_BENCH: print cycle counts of the LED hot paths */
+void GPIO_Bench(void);
+
+/* Inline pin access
+ *
+ * With a constant port and pin, as every pins.h definition is, these fold to
+ * a literal port address and bit mask: a set, clear or BSRR frame is a single
+ * store, a read a single load. The GPIO_* functions above are wrappers around
+ * them for callers with a runtime pin. The host simulation has no BSRR/BRR,
+ * so there they call the simulated GPIO_* functions, which trace every edge.
+ */
+#ifndef BOARD_SIM
+#define GPIO_IOPEN_BIT(port) \
+    ((port) == GPIOA ? RCC_IOPENR_GPIOAEN : (port) == GPIOB ? RCC_IOPENR_GPIOBEN : \
+     (port) == GPIOC ? RCC_IOPENR_GPIOCEN : 0U)
+
+static inline void gpio_set(GPIO_TypeDef *port, uint8_t pin) { port->BSRR = 1UL << pin; }
+static inline void gpio_clear(GPIO_TypeDef *port, uint8_t pin) { port->BRR = 1UL << pin; }
+static inline void gpio_toggle(GPIO_TypeDef *port, uint8_t pin) { port->ODR ^= 1UL << pin; }
+static inline uint8_t gpio_read(GPIO_TypeDef *port, uint8_t pin) { return (port->IDR >> pin) & 1U; }
+static inline void gpio_bsrr(GPIO_TypeDef *port, uint32_t bsrr) { port->BSRR = bsrr; }
+static inline void gpio_clock_enable(GPIO_TypeDef *port) { RCC->IOPENR |= GPIO_IOPEN_BIT(port); }
+
+/* Push-pull output, no pull resistor, clock enabled */
+static inline void gpio_output(GPIO_TypeDef *port, uint8_t pin, GPIO_Speed_t speed) {
+    uint32_t field = 3UL << (pin * 2U);
+    gpio_clock_enable(port);
+    port->MODER = (port->MODER & ~field) | ((uint32_t)GPIO_MODE_OUTPUT << (pin * 2U));
+    port->OTYPER &= ~(1UL << pin);
+    port->OSPEEDR = (port->OSPEEDR & ~field) | ((uint32_t)speed << (pin * 2U));
+    port->PUPDR &= ~field;
+}
+#else
+static inline void gpio_set(GPIO_TypeDef *port, uint8_t pin) { GPIO_SetPin(port, pin); }
+static inline void gpio_clear(GPIO_TypeDef *port, uint8_t pin) { GPIO_ClearPin(port, pin); }
+static inline void gpio_toggle(GPIO_TypeDef *port, uint8_t pin) { GPIO_TogglePin(port, pin); }
+static inline uint8_t gpio_read(GPIO_TypeDef *port, uint8_t pin) { return GPIO_ReadPin(port, pin); }
+static inline void gpio_bsrr(GPIO_TypeDef *port, uint32_t bsrr) { GPIO_WriteBSRR(port, bsrr); }
+static inline void gpio_clock_enable(GPIO_TypeDef *port) { GPIO_ClockEnable(port); }
+
+static inline void gpio_output(GPIO_TypeDef *port, uint8_t pin, GPIO_Speed_t speed) {
+    GPIO_ClockEnable(port);
+    GPIO_SetMode(port, pin, GPIO_MODE_OUTPUT);
+    GPIO_SetOutputType(port, pin, GPIO_OTYPE_PP);
+    GPIO_SetSpeed(port, pin, speed);
+    GPIO_SetPullUpDown(port, pin, GPIO_PUPD_NONE);
+}
+#endif
+
+/* The same by pins.h name, e.g. PIN_SET(LED1), PIN_READ(BTN) */
+#define PIN_SET(name)           gpio_set(name##_GPIO_PORT, name##_GPIO_PIN)
+#define PIN_CLEAR(name)         gpio_clear(name##_GPIO_PORT, name##_GPIO_PIN)
+#define PIN_TOGGLE(name)        gpio_toggle(name##_GPIO_PORT, name##_GPIO_PIN)
+#define PIN_READ(name)          gpio_read(name##_GPIO_PORT, name##_GPIO_PIN)
+#define PIN_OUTPUT(name, speed) gpio_output(name##_GPIO_PORT, name##_GPIO_PIN, (speed))
 
 #endif /* GPIO_H */
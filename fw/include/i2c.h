@@ -0,0 +1,20 @@
+#ifndef I2C_H
+#define I2C_H
+
+#include <stdint.h>
+
+/* I2C1 master transport. Transfers are blocking with timeouts and return
+   0 on success, -1 on NACK or timeout. */
+void i2c_init(uint32_t bus_hz);
+/* Recompute TIMINGR after a system clock change, between transfers */
+void i2c_clock_update(void);
+int i2c_master_write(uint8_t dev7, const uint8_t *buf, uint8_t len);
+int i2c_master_read(uint8_t dev7, uint8_t *buf, uint8_t len);
+
+/* Register snapshots for debugging */
+uint32_t i2c_get_isr(void);
+uint32_t i2c_get_cr1(void);
+uint32_t i2c_get_cr2(void);
+uint32_t i2c_get_timing(void);
+
+#endif /* I2C_H */
@@ -0,0 +1,39 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stdint.h>
+
+/* Short critical sections and the time an interrupt handler may read
+ *
+ * irq_save() masks interrupts and returns the previous PRIMASK for
+ * irq_restore(), so sections nest and can be entered from any handler.
+ * irq_now_us() is micros() on the target; in the simulator micros()
+ * advances simulated time, which a handler must not, so it reads the
+ * simulated clock instead.
+ */
+#ifndef BOARD_SIM
+#include "stm32c011xx.h"
+#include "timer.h"
+
+static inline uint32_t irq_save(void) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    return primask;
+}
+
+static inline void irq_restore(uint32_t primask) {
+    __set_PRIMASK(primask);
+}
+
+#define irq_now_us()    micros()
+#else
+#include "sim.h"
+
+/* Simulated interrupts only run inside sim_advance(), never in between */
+static inline uint32_t irq_save(void) { return 0; }
+static inline void irq_restore(uint32_t primask) { (void)primask; }
+
+#define irq_now_us()    ((uint32_t)sim_now_us())
+#endif
+
+#endif /* IRQ_H */
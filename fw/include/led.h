@@ -10,9 +10,6 @@ typedef enum {
     LED_MODE_BLINK
 } LED_Mode_t;
 
-/* LED auto-blink mode names: 0=OFF, 1=BLINK, 2=FADE, 3=CW, 4=STROBO, 5=ICIRCLE, 6=DISCO */
-extern const char *led_blink_mode_names[7];
-
 /* LED functions */
 void LED_Init(void);
 void LED_On(void);
@@ -22,4 +19,19 @@ void LED_SetMode(LED_Mode_t mode);
 LED_Mode_t LED_GetMode(void);
 void LED_Update(void);  /* Call periodically (e.g., every 1ms) for blink mode */
 
+/* Badge LEDs LED1..LED5 as a mask (bit 0 = LED1). A whole frame is applied
+   with one BSRR store per port from a precomputed table, so all LEDs change
+   together. led_write_mask() sets the LED engine's mask (BCM planes, CW). */
+#define LED_MASK_ALL    0x1FU
+void led_write_mask(uint8_t mask);
+/* Blinker LEDs, lit on top of the engine's mask: set the bits in which to
+   mask, keep the others */
+void led_write_bits(uint8_t mask, uint8_t which);
+/* At most n LEDs lit at once in the combined frame (the lowest numbered
+   ones win), LED_MAX_LIT_ALL for no limit */
+#define LED_MAX_LIT_ALL 5U
+void led_set_max_lit(uint8_t n);
+/* BSRR words for GPIOA, GPIOB and GPIOC that show mask */
+const uint32_t *led_mask_bsrr(uint8_t mask);
+
 #endif /* LED_H */
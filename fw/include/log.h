@@ -0,0 +1,52 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Deferred binary log
+ *
+ * LOG("fmt", args...) stores the format string in the log_fmt ELF section,
+ * which is never loaded to flash (STM32C011F6P6.ld), and queues only the
+ * string's offset in that section, a timestamp and the arguments as
+ * varints: a few bytes and no formatting on the device. Any context may
+ * log, ISRs included. The main loop sends whole records while it would
+ * otherwise sleep, once 'log on' is given; tools/logdecode.py turns the
+ * stream back into text using the format strings in the ELF.
+ *
+ * Arguments are integers of up to 32 bits (%u %d %x %X %c, optional width);
+ * no strings or pointers. At most LOG_ARGS_MAX of them.
+ *
+ * On the wire each record is framed as 0x00, COBS(payload), 0x00 so it can
+ * share the console with the CLI text, which never contains a 0x00. The
+ * payload is the format offset (16 bits, little endian), each argument and
+ * last the time since the previous record in microseconds, all unsigned
+ * LEB128 varints except the offset.
+ */
+#define LOG_RING_SIZE       128U    /* Queued record bytes */
+#define LOG_ARGS_MAX        4
+
+#define LOG(fmt, ...) do { \
+    static const char log_fmt_[] __attribute__((section("log_fmt"), used)) = fmt; \
+    const uint32_t log_args_[] = { 0, ##__VA_ARGS__ }; \
+    _Static_assert(sizeof(log_args_) / sizeof(uint32_t) <= LOG_ARGS_MAX + 1U, "too many LOG arguments"); \
+    log_write(log_fmt_, &log_args_[1], sizeof(log_args_) / sizeof(uint32_t) - 1U); \
+} while (0)
+
+/* From any context; the record is dropped and counted when the ring is full */
+void log_write(const char *fmt, const uint32_t *args, size_t n);
+
+/* Main loop, only while enabled: send the queued records that fit in
+   budget_us of UART time. Returns the time spent, 0 when nothing was sent. */
+uint32_t log_drain(uint32_t budget_us);
+
+void log_enable(bool on);
+bool log_enabled(void);
+void log_clear(void);
+
+uint32_t log_records(void);     /* Queued since boot */
+uint32_t log_dropped(void);     /* Lost to a full ring */
+uint16_t log_pending(void);     /* Bytes waiting in the ring */
+
+#endif /* LOG_H */
@@ -0,0 +1,41 @@
+#ifndef MEM_H
+#define MEM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* RAM use
+ *
+ * mem_paint() fills the RAM between the heap and the stack pointer with
+ * MEM_PAINT at boot; the lowest word that no longer holds it is as deep
+ * as the stack has been. The bottom MEM_GUARD bytes of the stack
+ * reservation (_Min_Stack_Size in the linker script) are the guard that
+ * mem_check() looks at.
+ */
+#define MEM_PAINT           0xC5C5C5C5UL
+#define MEM_GUARD           16U
+
+typedef struct {
+    uint16_t data;          /* .data, RAMFUNC code included */
+    uint16_t ramfunc;
+    uint16_t bss;
+    uint16_t noinit;
+    uint16_t heap;          /* Handed out by _sbrk */
+    uint16_t heap_max;      /* Up to the stack reservation */
+    uint16_t stack_peak;    /* Deepest since boot */
+    uint16_t stack_size;    /* Reserved */
+    uint16_t free;          /* Never touched by the heap or the stack */
+    bool guard_ok;
+} mem_info_t;
+
+/* First thing in main() */
+void mem_paint(void);
+/* Main loop, a few word compares: false once the stack has reached the
+   guard, which is traced and logged the first time */
+bool mem_check(void);
+void mem_info(mem_info_t *m);
+
+/* syscalls.c: bytes handed out by _sbrk */
+uint32_t sbrk_used(void);
+
+#endif /* MEM_H */
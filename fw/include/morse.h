@@ -0,0 +1,59 @@
+#ifndef MORSE_H
+#define MORSE_H
+
+#include <stdint.h>
+
+#include <stdbool.h>
+
+/* Morse code table, packed text and CW timeline encoder
+ *
+ * Messages are stored as 6-bit text: each character is its offset from 0x20
+ * (ASCII 0x20..0x5F, lower case folded to upper), four characters in three
+ * bytes, first character in the high bits. The encoder streams a timeline of
+ * one byte per element from it: the on time in units in the high nibble (0
+ * for a pause alone), the off time after it in the low nibble. Letters,
+ * digits, the usual punctuation and prosigns are supported; a prosign is
+ * written in angle brackets, e.g. <SK>, and its letters are sent without a
+ * character gap.
+ */
+#define MORSE_DIT_UNITS         1
+#define MORSE_DAH_UNITS         3
+#define MORSE_ELEMENT_GAP       1
+#define MORSE_CHAR_GAP          5       /* Element gap + 4 units, as fixed in v1.5.1 */
+#define MORSE_WORD_GAP          14      /* Character gap + 9 unit space */
+#define MORSE_SPACE             9       /* Space not following a character */
+
+#define MORSE_ON_UNITS(ev)      ((uint8_t)(ev) >> 4)
+#define MORSE_OFF_UNITS(ev)     ((uint8_t)(ev) & 0x0FU)
+
+#define MORSE_PACKED_BYTES(n)   (((n) * 6U + 7U) / 8U)
+
+/* Encoder state over packed text; the text is never expanded in RAM */
+typedef struct {
+    const uint8_t *packed;
+    uint8_t len;            /* Characters */
+    uint8_t pos;            /* Next character */
+    uint8_t code;           /* Elements left of the current character, as in morse_code() */
+    bool prosign;
+} morse_stream_t;
+
+/* Bit-packed code of c: a leading 1, then one bit per element from the
+   first, 1 = dah. 0 when c has no Morse code. */
+uint8_t morse_code(char c);
+/* Character for a packed code, 0 when there is none */
+char morse_char(uint8_t code);
+
+/* Check the next character of a message; *prosign tracks an open <..>
+   between calls (start with false, it must be false again at the end) */
+bool morse_accept(char c, bool *prosign);
+
+/* Character i of packed text */
+void morse_pack(uint8_t *packed, uint8_t i, char c);
+char morse_unpack(const uint8_t *packed, uint8_t i);
+
+/* Encode len characters of packed text; next() returns the next timeline
+   event, 0 at the end */
+void morse_stream_init(morse_stream_t *s, const uint8_t *packed, uint8_t len);
+uint8_t morse_stream_next(morse_stream_t *s);
+
+#endif /* MORSE_H */
@@ -0,0 +1,136 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* LED pattern bytecode
+ *
+ * A pattern is a byte string of opcodes with inline operands (16-bit operands
+ * little-endian). The interpreter keeps these registers:
+ *   mask    LEDs currently lit (bit 0 = LED1 .. bit 4 = LED5)
+ *   sel     selection built by PICK/PICK_SET/CURSOR, lit with SHOW
+ *   level   brightness of lit LEDs, 0..255
+ *   cursor  LED index for circular patterns, moved by STEP/REVERSE
+ *   var     wait time in ms for accelerating patterns
+ * Waits are scheduled from the previous deadline, so timing does not drift
+ * with main loop latency. Selecting another mode restarts the interpreter
+ * between any two instructions, including in the middle of a wait.
+ */
+enum {
+    PAT_OP_END = 0,     /* Restart from the first instruction */
+    PAT_OP_HALT,        /* Stop, LEDs keep their state */
+    PAT_OP_MASK,        /* m: light exactly the LEDs in m */
+    PAT_OP_SHOW,        /* Light the LEDs in sel */
+    PAT_OP_LEVEL,       /* b: brightness 0..255 */
+    PAT_OP_RAMP,        /* target, steps, step_ms: step brightness linearly to target */
+    PAT_OP_WAIT,        /* ms16 */
+    PAT_OP_WAIT_RAND,   /* lo16, hi16, step: random lo..hi ms in multiples of step */
+    PAT_OP_WAIT_VAR,    /* Wait var ms */
+    PAT_OP_SET_VAR,     /* ms16 */
+    PAT_OP_ADD_VAR,     /* delta (signed), limit16: var += delta, not past limit */
+    PAT_OP_LOOP,        /* n: repeat up to the matching NEXT n times */
+    PAT_OP_LOOP_RAND,   /* lo, hi: repeat lo..hi times */
+    PAT_OP_NEXT,
+    PAT_OP_PICK,        /* sel = one random LED, never the previous pick */
+    PAT_OP_PICK_SET,    /* lo, hi: sel = lo..hi distinct random LEDs */
+    PAT_OP_CURSOR,      /* sel = LED at cursor */
+    PAT_OP_STEP,        /* Move cursor one LED in the current direction */
+    PAT_OP_REVERSE,     /* Flip cursor direction */
+    PAT_OP_CHANCE,      /* p, n: skip the next n bytes with probability p/256 */
+    PAT_OP_CW,          /* Send the selected CW message once and pause 9 units (dit LED1+LED5, dah LED2..LED4) */
+};
+
+/* Table-building helpers */
+#define PAT_U16(v)              (uint8_t)((v) & 0xFFU), (uint8_t)(((v) >> 8) & 0xFFU)
+#define PAT_LEN(...)            sizeof((const uint8_t[]){ __VA_ARGS__ })
+
+#define P_END                   PAT_OP_END
+#define P_HALT                  PAT_OP_HALT
+#define P_MASK(m)               PAT_OP_MASK, (m)
+#define P_SHOW                  PAT_OP_SHOW
+#define P_LEVEL(b)              PAT_OP_LEVEL, (b)
+#define P_RAMP(to, n, ms)       PAT_OP_RAMP, (to), (n), (ms)
+#define P_WAIT(ms)              PAT_OP_WAIT, PAT_U16(ms)
+#define P_WAIT_RAND(lo, hi, st) PAT_OP_WAIT_RAND, PAT_U16(lo), PAT_U16(hi), (st)
+#define P_WAIT_VAR              PAT_OP_WAIT_VAR
+#define P_SET_VAR(ms)           PAT_OP_SET_VAR, PAT_U16(ms)
+#define P_ADD_VAR(d, lim)       PAT_OP_ADD_VAR, (uint8_t)(d), PAT_U16(lim)
+#define P_LOOP(n)               PAT_OP_LOOP, (n)
+#define P_LOOP_RAND(lo, hi)     PAT_OP_LOOP_RAND, (lo), (hi)
+#define P_NEXT                  PAT_OP_NEXT
+#define P_PICK                  PAT_OP_PICK
+#define P_PICK_SET(lo, hi)      PAT_OP_PICK_SET, (lo), (hi)
+#define P_CURSOR                PAT_OP_CURSOR
+#define P_STEP                  PAT_OP_STEP
+#define P_REVERSE               PAT_OP_REVERSE
+#define P_CW                    PAT_OP_CW
+/* Run the given instructions, but skip them with probability p/256 */
+#define P_MAYBE(p, ...)         PAT_OP_CHANCE, (p), PAT_LEN(__VA_ARGS__), __VA_ARGS__
+
+#define PATTERN_IDLE            0xFFFFFFFFUL    /* pattern_tick(): nothing scheduled */
+
+/* User patterns uploaded with 'pat load' follow the built-in modes. Each slot
+   in the storage free area holds { length, CRC-16 } and up to
+   PATTERN_USER_MAX code bytes; the interpreter reads them from storage through
+   a small window, the code is never copied to RAM as a whole. */
+#define PATTERN_USER_SLOTS      2
+#define PATTERN_USER_MAX        66
+
+/* Auto-blink modes: built-in patterns, then user slots */
+uint8_t pattern_count(void);
+const char *pattern_name(uint8_t mode);     /* NULL when out of range or an empty slot */
+bool pattern_is_user(uint8_t mode);
+
+/* CW messages, stored as packed text (morse.h) and never expanded in RAM.
+   Message 0 has the CW slot of its own; messages 1 and 2 take user slot 1
+   or 2 in place of a pattern, and message 1 runs on into slot 2 when it is
+   longer than one slot. */
+#define PATTERN_CW_MSGS         3
+#define PATTERN_CW_MSG_MAX      180     /* Message 1 over both user slots */
+
+/* Select the message PAT_OP_CW sends; -1 when it is empty (nothing is sent) */
+int pattern_cw_select(uint8_t msg);
+uint8_t pattern_cw_selected(void);
+/* Length of a message in characters (0 = empty) and the most it can hold */
+uint8_t pattern_cw_length(uint8_t msg);
+uint8_t pattern_cw_capacity(uint8_t msg);
+/* Up to 8 characters of a message from at (a multiple of 8) into out, no
+   NUL; returns the count, 0 past the end */
+uint8_t pattern_cw_read(uint8_t msg, uint8_t at, char *out);
+/* Streamed store: begin() empties the message, text() checks and packs each
+   piece of text straight to storage, end() commits the header. Any error
+   leaves the message empty. */
+int pattern_cw_begin(uint8_t msg);
+int pattern_cw_text(const char *text);
+int pattern_cw_end(void);
+/* Empty message 1 or 2, freeing its user slot(s) */
+int pattern_cw_delete(uint8_t msg);
+/* CW speed in words per minute (PARIS, 5..40); farnsworth_wpm below wpm
+   stretches the gaps between characters and words to that overall speed,
+   0 for none */
+void pattern_cw_speed(uint8_t wpm, uint8_t farnsworth_wpm);
+/* Called from the CW timer interrupt, see CW_TimerStart() */
+uint16_t pattern_cw_next(void);
+
+/* Check the user slots in storage; call after storage_init() and a reset */
+void pattern_init(void);
+/* Length and CRC of a loaded user slot, -1 when empty */
+int pattern_user_info(uint8_t mode, uint8_t *len, uint16_t *crc);
+/* CW message held in a user slot, -1 for none */
+int pattern_user_cw(uint8_t mode);
+
+/* Streamed upload into a user slot: begin() invalidates the slot (and any CW
+   message in it), data() writes
+   each chunk straight to storage, end() commits the header if the CRC-16
+   (CCITT, init 0xFFFF) over all data matches. */
+int pattern_load_begin(uint8_t mode);
+int pattern_load_data(const uint8_t *data, uint8_t len);
+int pattern_load_end(uint16_t crc);
+int pattern_delete(uint8_t mode);
+
+/* Run everything due at now_us for the given mode (restarting the interpreter
+   when the mode changed) and return the time until the next LED event. */
+uint32_t pattern_tick(uint8_t mode, uint32_t now_us);
+
+#endif /* PATTERN_H */
@@ -0,0 +1,38 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+/* Power source profiles
+ *
+ * BADGE_PWR_SENSE (PB6) is high while a host badge powers the SAO. Both
+ * edges of the pin record their time, and the first edge of a burst posts
+ * an EVENT_POWER to wake the main loop, so bounce takes one queue entry;
+ * once the pin has been quiet for POWER_SETTLE_US the main loop applies
+ * the profile of the new source:
+ * clock profile, LED brightness scale and the number of LEDs lit at once.
+ */
+#define POWER_SETTLE_US             50000U  /* Connector bounce on plugging */
+#define POWER_BATTERY_BRIGHTNESS    64U     /* Of 255 */
+#define POWER_BATTERY_MAX_LIT       2U
+#define POWER_IDLE                  0xFFFFFFFFUL    /* power_tick(): nothing pending */
+
+typedef enum {
+    POWER_BATTERY,      /* Battery or SWD */
+    POWER_BADGE,
+    POWER_SOURCES
+} power_source_t;
+
+/* Apply the profile for the current pin level and enable its interrupt */
+void power_init(void);
+/* EXTI interrupt: an edge to level at t_us */
+void power_edge(uint8_t level, uint32_t t_us);
+/* Main loop: applies a settled change; returns the us until it is due */
+uint32_t power_tick(uint32_t now_us);
+
+uint8_t power_source(void);
+const char *power_source_name(uint8_t source);
+/* Profile changes to source since boot */
+uint16_t power_switches(uint8_t source);
+
+#endif /* POWER_H */
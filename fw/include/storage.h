@@ -0,0 +1,29 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Configuration storage backends. Addresses are 24C02 logical addresses so the
+   layout in EEPROM_STRUCTURE.md applies to both; the flash backend only holds the
+   firmware-owned part (STORAGE_FLASH_BASE..0xFF), the SAO descriptor below it
+   always stays in the external EEPROM. */
+typedef enum {
+    STORAGE_NONE = 0,
+    STORAGE_EEPROM,     /* 24C02 on I2C1 */
+    STORAGE_FLASH       /* Emulated EEPROM in the last MCU flash pages */
+} Storage_Backend_t;
+
+#define STORAGE_FLASH_BASE  0x34U   /* Word-aligned start covering [[MARKER]] at 0x36 */
+
+/* Probe the 24C02 and select the backend per STORAGE_BACKEND in config.h */
+void storage_init(void);
+Storage_Backend_t storage_backend(void);
+const char *storage_backend_name(void);
+bool storage_eeprom_present(void);
+
+int storage_read(uint16_t addr, uint8_t *buf, uint16_t len);
+/* Differential write, *written (may be NULL) receives the number of changed bytes */
+int storage_update(uint16_t addr, const uint8_t *data, uint16_t len, uint16_t *written);
+
+#endif /* STORAGE_H */
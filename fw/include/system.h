@@ -12,4 +12,28 @@ void System_ClockConfig(void);
 /* Get system clock frequency */
 uint32_t System_GetClock(void);
 
+/* Clock profiles. Switching waits for the UART to finish sending, then
+   reprograms the flash wait states, SysTick, the running timers, the USART
+   baud rate registers and I2C TIMINGR for the new clock. */
+typedef enum {
+    CLOCK_ECO,          /* SYSTEM_CLOCK_HZ, the boot clock */
+    CLOCK_PERF,         /* SYSTEM_CLOCK_PERF_HZ */
+    CLOCK_PROFILES
+} clock_profile_t;
+
+/* Returns -1 for an unknown profile */
+int System_SetClockProfile(uint8_t profile);
+uint8_t System_GetClockProfile(void);
+const char *System_ClockProfileName(uint8_t profile);
+
+/* Sleep until the next interrupt (WFI) */
+void System_Sleep(void);
+
+/* Software reset (does not return) */
+void System_Reset(void);
+
+/* Software reset into the UART bootloader (include/bootloader.h), which
+   also listens on the SAO USART2 when that is enabled. Does not return. */
+void System_EnterBootloader(void);
+
 #endif /* SYSTEM_H */
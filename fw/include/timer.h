@@ -5,6 +5,9 @@
 
 /* Timer initialization */
 void Timer_Init(void);
+/* After a system clock change, interrupts masked: SysTick reload and the
+   prescalers of the running timers */
+void Timer_ClockUpdate(void);
 
 /* Delay functions */
 void delay_us(uint32_t us);
@@ -17,4 +20,16 @@ uint32_t micros(void);
 void PWM_Init(void);
 void PWM_SetDutyCycle(uint8_t channel, uint8_t duty_cycle);
 
+/* CW keying timer (TIM17 at 1 kHz): the compare interrupt calls
+   pattern_cw_next() first_ms from now and then whenever the returned time
+   has passed, advancing the compare register so edges never drift. Stops
+   when it returns 0. */
+void CW_TimerStart(uint16_t first_ms);
+void CW_TimerStop(void);
+
+/* Main loop wake-up (TIM16 one-pulse at 1 MHz): posts EVENT_TIMER us from
+   now, replacing any wake-up still pending */
+void Wake_TimerStart(uint16_t us);
+void Wake_TimerStop(void);
+
 #endif /* TIMER_H */
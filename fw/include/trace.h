@@ -0,0 +1,56 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Event trace
+ *
+ * A ring of the last TRACE_ENTRIES events with their micros() time, always
+ * recording. It lives in .noinit, so it keeps its contents over a soft
+ * reset (reboot, watchdog, fault) and 'trace dump' shows what led up to
+ * it; after power-on it starts empty. Any context may record; an entry is
+ * 8 bytes and the insert runs with interrupts masked for a few
+ * instructions.
+ */
+#define TRACE_ENTRIES       32
+
+typedef enum {
+    TRACE_BOOT,         /* a: 1 when the ring was kept over a reset */
+    TRACE_MODE,         /* a: auto-blink mode, arg: the previous one */
+    TRACE_BUTTON,       /* Accepted level. a: 1 down, arg: edges since the last one */
+    TRACE_STORE_READ,   /* Config storage. a: length, arg: address */
+    TRACE_STORE_WRITE,
+    TRACE_STORE_DONE,   /* a: 1 failed, arg: duration in us */
+    TRACE_UART_OVERRUN, /* a: USART 1 or 2, arg: 0 RX ring full, 1 in the USART */
+    TRACE_CMD,          /* CLI command. a: length, arg: first two characters */
+    TRACE_CMD_DONE,     /* arg: duration in us */
+    TRACE_CLOCK,        /* a: clock_profile_t, arg: MHz */
+    TRACE_POWER,        /* a: power source */
+    TRACE_FAULT,        /* HardFault, reset follows. arg: PC bits 15..0 */
+    TRACE_STACK,        /* Stack reached the guard. arg: address bits 15..0 */
+    TRACE_WATCHDOG,     /* Task starved, reset follows. a: watchdog_task_t, arg: busy ms */
+    TRACE_TYPES
+} trace_type_t;
+
+typedef struct {
+    uint32_t t_us;
+    uint16_t arg;
+    uint8_t type;
+    uint8_t a;
+} trace_entry_t;
+
+/* At boot, after Timer_Init: clears the ring unless it survived a reset */
+void trace_init(void);
+/* From any context */
+void trace(uint8_t type, uint8_t a, uint16_t arg);
+/* Microseconds since t0_us for a duration argument, 0xFFFF at most */
+uint16_t trace_since(uint32_t t0_us);
+
+uint8_t trace_count(void);
+/* Entry i, 0 being the oldest; false past the end */
+bool trace_get(uint8_t i, trace_entry_t *e);
+const char *trace_type_name(uint8_t type);
+void trace_clear(void);
+
+#endif /* TRACE_H */
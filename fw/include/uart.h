@@ -16,6 +16,16 @@ void UART_SendChar(char c);
 void UART_SendString(const char *str);
 void UART_SendData(const uint8_t *data, uint32_t len);
 
+/* Wait until the last character has left both UARTs */
+void UART_Flush(void);
+/* Console baud rate on both UARTs, not saved. Returns -1 when the current
+   system clock cannot produce it (BRR below 16 or above 0xFFFF). */
+int UART_SetBaud(uint32_t baud);
+uint32_t UART_GetBaud(void);
+/* After a system clock change: the same baud rate, or UART_BAUDRATE when
+   the new clock cannot produce it */
+void UART_ClockUpdate(void);
+
 /* UART receive functions */
 int UART_ReceiveChar(char *c);  /* Non-blocking: returns 1 if char available, 0 otherwise */
 uint32_t UART_Available(void);   /* Returns number of bytes available */
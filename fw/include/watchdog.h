@@ -0,0 +1,44 @@
+#ifndef WATCHDOG_H
+#define WATCHDOG_H
+
+#include <stdint.h>
+
+/* Task supervision on the independent watchdog
+ *
+ * Each supervised task brackets its work with watchdog_begin() and
+ * watchdog_end(): one store each. The system tick checks that no task has
+ * been busy for longer than its deadline and only then refreshes the IWDG.
+ * A task that overruns is recorded in .noinit and the IWDG is left to
+ * reset the badge; with interrupts stuck off the tick stops too and the
+ * IWDG resets it on its own. 'dmesg' and 'status' report the resets since
+ * power-on and which task starved.
+ */
+#define WATCHDOG_IWDG_MS        1000U   /* IWDG timeout without refresh */
+#define WATCHDOG_CLI_MS         5000U   /* One main loop pass, commands included */
+#define WATCHDOG_LED_MS         250U    /* One pattern_tick() */
+#define WATCHDOG_STORAGE_MS     1000U   /* One storage read or update */
+
+typedef enum {
+    WATCHDOG_CLI,
+    WATCHDOG_LED,
+    WATCHDOG_STORAGE,
+    WATCHDOG_TASKS,
+    WATCHDOG_NONE = WATCHDOG_TASKS  /* Reset without a starved task: the tick stopped */
+} watchdog_task_t;
+
+/* Before the main loop, after fault_init(): counts a watchdog reset and
+   starts the IWDG. It cannot be stopped again until the next reset. */
+void watchdog_init(void);
+/* System tick, every millisecond */
+void watchdog_tick(void);
+
+void watchdog_begin(watchdog_task_t task);
+void watchdog_end(watchdog_task_t task);
+
+uint32_t watchdog_resets(void);         /* Since power-on */
+/* Of the last watchdog reset; WATCHDOG_NONE when the tick had stopped */
+watchdog_task_t watchdog_last_task(void);
+uint32_t watchdog_last_boot(void);      /* fault_boots() of the run that was reset */
+const char *watchdog_task_name(watchdog_task_t task);
+
+#endif /* WATCHDOG_H */
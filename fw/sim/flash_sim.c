@@ -0,0 +1,76 @@
+/* Simulated flash EEPROM emulation pages: erase/program rules and timing */
+
+#include "flash.h"
+#include "sim.h"
+
+#include <string.h>
+
+#define SIM_FLASH_ERASE_US      22000U  /* Page erase, typical */
+#define SIM_FLASH_PROGRAM_US    85U     /* Double-word program, typical */
+#define SIM_FLASH_SIZE          (FLASH_EMU_PAGES * FLASH_EMU_PAGE_SIZE)
+
+uint8_t _fee_start[SIM_FLASH_SIZE];
+
+static bool flash_locked = true;
+static bool flash_loaded;
+
+static void flash_blank(void) {
+    if (!flash_loaded) memset(_fee_start, 0xFF, sizeof(_fee_start));
+    flash_loaded = true;
+}
+
+void Flash_Unlock(void) {
+    flash_blank();
+    flash_locked = false;
+}
+
+void Flash_Lock(void) {
+    flash_locked = true;
+}
+
+int Flash_ErasePage(const void *page) {
+    size_t off = (size_t)((const uint8_t *)page - _fee_start);
+
+    flash_blank();
+    if (flash_locked || off >= SIM_FLASH_SIZE || off % FLASH_EMU_PAGE_SIZE) return -1;
+    memset(&_fee_start[off], 0xFF, FLASH_EMU_PAGE_SIZE);
+    sim_stats.flash_erases++;
+    sim_advance(SIM_FLASH_ERASE_US);
+    return 0;
+}
+
+int Flash_ProgramDoubleWord(const void *addr, uint32_t lo, uint32_t hi) {
+    size_t off = (size_t)((const uint8_t *)addr - _fee_start);
+    uint8_t data[8];
+
+    flash_blank();
+    if (flash_locked || off >= SIM_FLASH_SIZE || off % 8U) return -1;
+    /* Programming a non-erased double word is a PROGERR on the real part */
+    for (unsigned i = 0; i < 8; i++) {
+        if (_fee_start[off + i] != 0xFF) return -1;
+    }
+    memcpy(&data[0], &lo, 4);
+    memcpy(&data[4], &hi, 4);
+    memcpy(&_fee_start[off], data, 8);
+    sim_stats.flash_programs++;
+    sim_advance(SIM_FLASH_PROGRAM_US);
+    return 0;
+}
+
+int sim_flash_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    memset(_fee_start, 0xFF, sizeof(_fee_start));
+    flash_loaded = true;
+    if (!f) return -1;
+    size_t n = fread(_fee_start, 1, sizeof(_fee_start), f);
+    fclose(f);
+    return (n == sizeof(_fee_start)) ? 0 : -1;
+}
+
+int sim_flash_save(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = fwrite(_fee_start, 1, sizeof(_fee_start), f);
+    fclose(f);
+    return (n == sizeof(_fee_start)) ? 0 : -1;
+}
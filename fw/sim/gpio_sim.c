@@ -0,0 +1,162 @@
+/* Simulated GPIO ports A/B/C with EXTI and LED edge tracing */
+
+#include "gpio.h"
+#include "pins.h"
+#include "sim.h"
+
+GPIO_TypeDef sim_gpio[3];
+
+/* Externally driven input levels (button, BADGE_PWR_SENSE) */
+static uint32_t ext_mask[3];
+static uint32_t ext_level[3];
+
+/* EXTI line configuration: source port and edge per line */
+static GPIO_TypeDef *exti_port[16];
+static GPIO_Edge_t exti_edge[16];
+
+/* Pins that appear in the LED trace */
+static const struct {
+    GPIO_TypeDef *port;
+    uint8_t pin;
+    const char *name;
+} traced[] = {
+    { LED1_GPIO_PORT, LED1_GPIO_PIN, "LED1" },
+    { LED2_GPIO_PORT, LED2_GPIO_PIN, "LED2" },
+    { LED3_GPIO_PORT, LED3_GPIO_PIN, "LED3" },
+    { LED4_GPIO_PORT, LED4_GPIO_PIN, "LED4" },
+    { LED5_GPIO_PORT, LED5_GPIO_PIN, "LED5" },
+    { LED_GPIO_PORT,  LED_GPIO_PIN,  "DBG"  },
+};
+
+static unsigned port_index(const void *port) {
+    return (unsigned)((const GPIO_TypeDef *)port - sim_gpio);
+}
+
+/* Level seen on IDR: external driver, else own output, else pull resistor */
+static uint8_t pin_level(GPIO_TypeDef *gpio, uint8_t pin) {
+    unsigned p = port_index(gpio);
+    uint32_t bit = 1UL << pin;
+    uint32_t mode = (gpio->MODER >> (pin * 2)) & 3U;
+
+    if (ext_mask[p] & bit) return (ext_level[p] & bit) ? 1 : 0;
+    if (mode == GPIO_MODE_OUTPUT) return (gpio->ODR & bit) ? 1 : 0;
+    return (((gpio->PUPDR >> (pin * 2)) & 3U) == GPIO_PUPD_PU) ? 1 : 0;
+}
+
+static void update_idr(GPIO_TypeDef *gpio, uint8_t pin) {
+    uint32_t bit = 1UL << pin;
+    uint8_t old = (gpio->IDR & bit) ? 1 : 0;
+    uint8_t now = pin_level(gpio, pin);
+
+    if (now) gpio->IDR |= bit; else gpio->IDR &= ~bit;
+    if (old == now || exti_port[pin] != gpio) return;
+    GPIO_Edge_t edge = now ? GPIO_EDGE_RISING : GPIO_EDGE_FALLING;
+    if (exti_edge[pin] & edge) GPIO_EXTI_Callback(pin, edge);
+}
+
+static void write_odr(GPIO_TypeDef *gpio, uint32_t set, uint32_t clr) {
+    uint32_t old = gpio->ODR;
+    uint32_t now = (old & ~clr) | set;     /* Set wins, as in BSRR */
+    uint32_t changed = old ^ now;
+
+    gpio->ODR = now;
+    if (!changed) return;
+    for (unsigned i = 0; i < sizeof(traced) / sizeof(traced[0]); i++) {
+        uint32_t bit = 1UL << traced[i].pin;
+        if (traced[i].port == gpio && (changed & bit)) {
+            sim_led_edge(traced[i].name, (now & bit) ? 1 : 0);
+        }
+    }
+    for (uint8_t pin = 0; pin < 16; pin++) {
+        if (changed & (1UL << pin)) update_idr(gpio, pin);
+    }
+}
+
+void sim_gpio_init(void) {
+    for (unsigned p = 0; p < 3; p++) {
+        sim_gpio[p].MODER = 0xFFFFFFFFU;    /* Reset state: analog */
+        sim_gpio[p].IDR = 0;
+    }
+}
+
+void sim_gpio_drive(void *port, uint8_t pin, int level) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    unsigned p = port_index(gpio);
+    uint32_t bit = 1UL << pin;
+
+    if (level < 0) {
+        ext_mask[p] &= ~bit;
+    } else {
+        ext_mask[p] |= bit;
+        if (level) ext_level[p] |= bit; else ext_level[p] &= ~bit;
+    }
+    update_idr(gpio, pin);
+}
+
+void GPIO_ClockEnable(void *port) {
+    (void)port;
+}
+
+void GPIO_SetMode(void *port, uint8_t pin, GPIO_Mode_t mode) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    gpio->MODER &= ~(3U << (pin * 2));
+    gpio->MODER |= (mode << (pin * 2));
+    update_idr(gpio, pin);
+}
+
+void GPIO_SetOutputType(void *port, uint8_t pin, GPIO_OType_t otype) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    if (otype == GPIO_OTYPE_OD) gpio->OTYPER |= (1U << pin);
+    else gpio->OTYPER &= ~(1U << pin);
+}
+
+void GPIO_SetSpeed(void *port, uint8_t pin, GPIO_Speed_t speed) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    gpio->OSPEEDR &= ~(3U << (pin * 2));
+    gpio->OSPEEDR |= (speed << (pin * 2));
+}
+
+void GPIO_SetPullUpDown(void *port, uint8_t pin, GPIO_PuPd_t pupd) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    gpio->PUPDR &= ~(3U << (pin * 2));
+    gpio->PUPDR |= (pupd << (pin * 2));
+    update_idr(gpio, pin);
+}
+
+void GPIO_SetAlternateFunction(void *port, uint8_t pin, uint8_t af) {
+    (void)port; (void)pin; (void)af;
+}
+
+void GPIO_SetPin(void *port, uint8_t pin) {
+    write_odr((GPIO_TypeDef *)port, 1U << pin, 0);
+}
+
+void GPIO_ClearPin(void *port, uint8_t pin) {
+    write_odr((GPIO_TypeDef *)port, 0, 1U << pin);
+}
+
+void GPIO_TogglePin(void *port, uint8_t pin) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    uint32_t bit = 1U << pin;
+    if (gpio->ODR & bit) write_odr(gpio, 0, bit);
+    else write_odr(gpio, bit, 0);
+}
+
+uint8_t GPIO_ReadPin(void *port, uint8_t pin) {
+    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
+    return (gpio->IDR & (1U << pin)) ? 1 : 0;
+}
+
+void GPIO_WriteBSRR(void *port, uint32_t bsrr) {
+    write_odr((GPIO_TypeDef *)port, bsrr & 0xFFFFU, bsrr >> 16);
+}
+
+void GPIO_EnableIRQ(void *port, uint8_t pin, GPIO_Edge_t edge) {
+    exti_port[pin] = (GPIO_TypeDef *)port;
+    exti_edge[pin] = edge;
+}
+
+__attribute__((weak)) void GPIO_EXTI_Callback(uint8_t pin, GPIO_Edge_t edge) {
+    (void)pin;
+    (void)edge;
+}
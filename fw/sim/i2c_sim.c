@@ -0,0 +1,91 @@
+/* Simulated I2C1 bus with a 24C02 at 0x50
+ *
+ * Models what the firmware can observe: byte timing at the configured bus
+ * speed, the 8-byte page rollover on writes, the sequential read address
+ * counter and NACKs during the internal write cycle (tWR).
+ */
+
+#include "i2c.h"
+#include "i2c_eeprom.h"
+#include "pins.h"
+#include "sim.h"
+
+#include <string.h>
+
+#define SIM_EEPROM_TWR_US   5000U   /* Datasheet maximum */
+
+static uint8_t eeprom_mem[EEPROM_SIZE];
+static uint8_t eeprom_ptr;
+static uint64_t eeprom_busy_until;
+static uint32_t byte_us = 450;     /* 9 bit times at 20 kHz */
+static bool eeprom_loaded;
+
+static bool eeprom_acks(uint8_t dev7) {
+    if (sim_config.eeprom_absent || dev7 != ((EEPROM_I2C_ADDR >> 1) & 0x7F)) return false;
+    if (sim_now_us() < eeprom_busy_until) {
+        sim_stats.eeprom_busy_naks++;
+        return false;
+    }
+    return true;
+}
+
+void i2c_init(uint32_t bus_hz) {
+    byte_us = (9U * 1000000U) / (bus_hz ? bus_hz : 20000U);
+    if (!eeprom_loaded) memset(eeprom_mem, 0xFF, sizeof(eeprom_mem));   /* Blank part */
+    eeprom_loaded = true;
+}
+
+int i2c_master_write(uint8_t dev7, const uint8_t *buf, uint8_t len) {
+    if (!eeprom_acks(dev7)) {
+        sim_advance(byte_us);
+        return -1;
+    }
+    sim_advance(byte_us * (1U + len));
+
+    eeprom_ptr = buf[0];
+    if (len > 1) {
+        /* Page write: address counter rolls over within the 8-byte page */
+        for (uint8_t i = 1; i < len; i++) {
+            eeprom_mem[eeprom_ptr] = buf[i];
+            eeprom_ptr = (uint8_t)((eeprom_ptr & ~(EEPROM_PAGE_SIZE - 1U)) |
+                                   ((eeprom_ptr + 1U) & (EEPROM_PAGE_SIZE - 1U)));
+        }
+        sim_stats.eeprom_bytes_written += len - 1U;
+        sim_stats.eeprom_write_cycles++;
+        eeprom_busy_until = sim_now_us() + SIM_EEPROM_TWR_US;
+    }
+    return 0;
+}
+
+int i2c_master_read(uint8_t dev7, uint8_t *buf, uint8_t len) {
+    if (!eeprom_acks(dev7)) {
+        sim_advance(byte_us);
+        return -1;
+    }
+    sim_advance(byte_us * (1U + len));
+    for (uint8_t i = 0; i < len; i++) buf[i] = eeprom_mem[eeprom_ptr++];
+    return 0;
+}
+
+uint32_t i2c_get_isr(void) { return 0; }
+uint32_t i2c_get_cr1(void) { return 0; }
+uint32_t i2c_get_cr2(void) { return 0; }
+uint32_t i2c_get_timing(void) { return 0; }
+
+int sim_eeprom_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    memset(eeprom_mem, 0xFF, sizeof(eeprom_mem));
+    eeprom_loaded = true;
+    if (!f) return -1;      /* Missing image: start with a blank part */
+    size_t n = fread(eeprom_mem, 1, sizeof(eeprom_mem), f);
+    fclose(f);
+    return (n == sizeof(eeprom_mem)) ? 0 : -1;
+}
+
+int sim_eeprom_save(const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (!f) return -1;
+    size_t n = fwrite(eeprom_mem, 1, sizeof(eeprom_mem), f);
+    fclose(f);
+    return (n == sizeof(eeprom_mem)) ? 0 : -1;
+}
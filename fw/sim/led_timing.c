@@ -0,0 +1,672 @@
+/* LED timing conformance and benchmark suite (make check)
+ *
+ * Boots the firmware in the host simulator, steps through every auto-blink
+ * mode with 'bm N' and records every LED1..LED5 edge with its virtual
+ * timestamp. Each mode's pulse train is then checked against the timing spec
+ * below and the deviation from nominal is reported as jitter statistics,
+ * together with the host time spent simulating the mode.
+ *
+ * The spec is written out here independently of src/pattern.c on purpose: a
+ * change to the mode code that alters timing must show up as a failure.
+ */
+
+#include "sim.h"
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define LED_COUNT           5
+#define TOL_US              1000        /* Allowed error on ms-scale timing */
+#define MAX_REPORTED_FAILS  5
+
+/* CW: 100 ms unit; gaps as fixed in v1.5.1 (see top-level README errata) */
+#define CW_MESSAGE          "CQ CQ DE SAO2/P SAO2 <AR>"     /* Longer than the old 20 chars */
+#define CW_UNIT_US          100000
+#define CW_DIT_UNITS        1
+#define CW_DAH_UNITS        3
+#define CW_ELEMENT_GAP      1           /* Between elements of one character */
+#define CW_CHAR_GAP         5           /* Between characters (1 + 4) */
+#define CW_WORD_GAP         14          /* Character gap + 9 unit space */
+#define CW_REPEAT_GAP       14          /* Character gap + 9 unit pause */
+/* CW at 30 wpm with Farnsworth spacing for 15 wpm overall (PARIS): 40 ms
+   units inside characters; character, word and repeat gaps in units of
+   ta / 19 (ARRL: ta = (60c - 37.2s) / (sc) s), whole milliseconds */
+#define CW_FAST_WPM         30
+#define CW_FAST_FARNSWORTH  15
+
+/* BLINK: one LED at a time, never the same LED twice in a row */
+#define BLINK_ON_MIN_US     10000
+#define BLINK_ON_MAX_US     80000
+#define BLINK_ON_GRID_US    10000
+#define BLINK_GAP_MIN_US    50000
+#define BLINK_GAP_MAX_US    1050000
+#define BLINK_GAP_GRID_US   25000
+
+/* FADE: 100 ms full on, then a linear ramp from 255 to 0 in 20 steps of
+   15 ms, dimmed by the BCM driver: 8 bit planes of 16 us << k make a 4.08 ms
+   frame with level * 16 us on-time, a new level starts with the next frame */
+#define FADE_HOLD_US        100000
+#define FADE_STEPS          20
+#define FADE_STEP_US        15000
+#define FADE_END_US         (FADE_HOLD_US + FADE_STEPS * FADE_STEP_US)
+#define FADE_GAP_MIN_US     200000
+#define FADE_GAP_MAX_US     1200000
+#define BCM_BASE_US         16
+#define BCM_FRAME_US        (255 * BCM_BASE_US)
+#define BCM_TOL_US          1
+
+/* STROBO: 1..4 LEDs flash together */
+#define STROBO_ON_MIN_US    30000
+#define STROBO_ON_MAX_US    70000
+#define STROBO_GAP_MIN_US   40000
+#define STROBO_GAP_MAX_US   390000      /* 90 ms flash gap + 300 ms pause */
+
+/* STROBO/ICIRCLE/DISCO: pattern waits are whole milliseconds */
+#define CHUNK_GRID_US       1000
+#define ICIRCLE_ON_MIN_US   25000
+#define ICIRCLE_ON_MAX_US   150000      /* Step LED continuing into a 50 ms double blink */
+#define DISCO_ON_MIN_US     20000
+#define DISCO_ON_MAX_US     750000
+
+typedef struct {
+    uint64_t t_us;
+    uint64_t host_ns;
+    uint8_t led;
+    uint8_t level;
+} edge_t;
+
+typedef struct {
+    uint64_t start;
+    uint64_t end;
+    uint8_t led;
+} pulse_t;
+
+typedef struct {
+    uint32_t n;
+    double sum;
+    double sumsq;
+    int64_t min;
+    int64_t max;
+} stat_t;
+
+typedef struct {
+    uint8_t mode;
+    const char *name;
+    uint32_t switch_ms;     /* 'bm N' sent */
+    uint32_t start_ms;      /* Analysis window, after the old mode settled */
+    uint32_t end_ms;
+    const char *setup;      /* Command sent 1 s before the switch, or NULL */
+    uint32_t unit_us;       /* CW: dit length */
+    uint32_t space_us;      /* CW: unit of the gaps between characters */
+    /* Results */
+    pulse_t *pulses;
+    size_t npulses;
+    uint32_t glitches;      /* Zero-width on/off glitches merged away */
+    uint32_t fails;
+    stat_t err;
+    double host_ms;
+} window_t;
+
+static window_t windows[] = {
+    { .mode = 1, .name = "BLINK", .switch_ms = 2000, .start_ms = 5000, .end_ms = 125000 },
+    { .mode = 2, .name = "FADE", .switch_ms = 125000, .start_ms = 128000, .end_ms = 188000 },
+    { .mode = 3, .name = "CW", .switch_ms = 188000, .start_ms = 191000, .end_ms = 251000,
+      .unit_us = CW_UNIT_US, .space_us = CW_UNIT_US },
+    { .mode = 4, .name = "STROBO", .switch_ms = 251000, .start_ms = 254000, .end_ms = 284000 },
+    { .mode = 5, .name = "ICIRCLE", .switch_ms = 284000, .start_ms = 287000, .end_ms = 317000 },
+    { .mode = 6, .name = "DISCO", .switch_ms = 317000, .start_ms = 320000, .end_ms = 350000 },
+    { .mode = 0, .name = "OFF", .switch_ms = 350000, .start_ms = 353000, .end_ms = 363000 },
+    { .mode = 3, .name = "CW30F", .switch_ms = 365000, .start_ms = 366000, .end_ms = 426000,
+      .setup = "cwspeed 30 15" },
+};
+#define WINDOW_COUNT    (sizeof(windows) / sizeof(windows[0]))
+
+static edge_t *edges;
+static size_t nedges, edges_cap;
+static bool verbose;
+
+static uint64_t host_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000U + (uint64_t)ts.tv_nsec;
+}
+
+static void record_edge(uint64_t t_us, const char *pin, uint8_t level) {
+    if (strncmp(pin, "LED", 3) != 0 || pin[3] < '1' || pin[3] > '5') return;
+    if (nedges == edges_cap) {
+        edges_cap = edges_cap ? edges_cap * 2 : 4096;
+        edges = realloc(edges, edges_cap * sizeof(*edges));
+        if (!edges) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    edges[nedges++] = (edge_t){ t_us, host_now_ns(), (uint8_t)(pin[3] - '1'), level };
+}
+
+static void stat_add(stat_t *s, int64_t v) {
+    if (s->n == 0 || v < s->min) s->min = v;
+    if (s->n == 0 || v > s->max) s->max = v;
+    s->n++;
+    s->sum += (double)v;
+    s->sumsq += (double)v * (double)v;
+}
+
+static double stat_mean(const stat_t *s) {
+    return s->n ? s->sum / s->n : 0.0;
+}
+
+static double stat_sd(const stat_t *s) {
+    if (s->n < 2) return 0.0;
+    double m = stat_mean(s);
+    double var = s->sumsq / s->n - m * m;
+    return var > 0.0 ? sqrt(var) : 0.0;
+}
+
+static void fail(window_t *w, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void fail(window_t *w, const char *fmt, ...) {
+    va_list ap;
+    if (w->fails++ >= MAX_REPORTED_FAILS && !verbose) return;
+    va_start(ap, fmt);
+    printf("  FAIL %s: ", w->name);
+    vprintf(fmt, ap);
+    printf("\n");
+    va_end(ap);
+}
+
+/* Error against the nearest multiple of grid */
+static int64_t grid_residual(uint64_t v, uint64_t grid) {
+    uint64_t n = (v + grid / 2) / grid;
+    return (int64_t)v - (int64_t)(n * grid);
+}
+
+static bool in_range(uint64_t v, uint64_t lo, uint64_t hi, uint64_t tol) {
+    return v + tol >= lo && v <= hi + tol;
+}
+
+static int pulse_cmp(const void *a, const void *b) {
+    const pulse_t *pa = a, *pb = b;
+    if (pa->start != pb->start) return pa->start < pb->start ? -1 : 1;
+    return (int)pa->led - (int)pb->led;
+}
+
+/* Turn the edge log into complete pulses inside the window. Edges at the
+   same instant are taken together: an LED cleared and set again with no
+   time in between stays lit, and one set and cleared never lit; both are
+   counted as glitches. */
+static void collect_pulses(window_t *w) {
+    uint64_t w0 = (uint64_t)w->start_ms * 1000U, w1 = (uint64_t)w->end_ms * 1000U;
+    uint64_t on_since[LED_COUNT] = { 0 };
+    bool on[LED_COUNT] = { false };
+    size_t cap = 256;
+    uint64_t host0 = 0, host1 = 0;
+
+    w->pulses = malloc(cap * sizeof(pulse_t));
+    for (size_t i = 0, j; i < nedges && edges[i].t_us <= w1; i = j) {
+        uint64_t t = edges[i].t_us;
+        bool level[LED_COUNT], toggled[LED_COUNT] = { false };
+
+        memcpy(level, on, sizeof(level));
+        for (j = i; j < nedges && edges[j].t_us == t; j++) {
+            if (edges[j].level != level[edges[j].led]) toggled[edges[j].led] = true;
+            level[edges[j].led] = edges[j].level;
+        }
+        if (t >= w0) {
+            if (!host0) host0 = edges[i].host_ns;
+            host1 = edges[j - 1].host_ns;
+        }
+        for (uint8_t l = 0; l < LED_COUNT; l++) {
+            if (level[l] == on[l]) {
+                if (toggled[l] && t >= w0) w->glitches++;
+                continue;
+            }
+            on[l] = level[l];
+            if (on[l]) {
+                on_since[l] = t;
+                continue;
+            }
+            if (on_since[l] < w0) continue;
+            if (w->npulses == cap) {
+                cap *= 2;
+                w->pulses = realloc(w->pulses, cap * sizeof(pulse_t));
+            }
+            w->pulses[w->npulses++] = (pulse_t){ on_since[l], t, l };
+        }
+    }
+    qsort(w->pulses, w->npulses, sizeof(pulse_t), pulse_cmp);
+    w->host_ms = (host1 - host0) / 1e6;
+}
+
+static void check_blink(window_t *w) {
+    for (size_t i = 0; i < w->npulses; i++) {
+        const pulse_t *p = &w->pulses[i];
+        uint64_t on = p->end - p->start;
+
+        if (!in_range(on, BLINK_ON_MIN_US, BLINK_ON_MAX_US, TOL_US)) {
+            fail(w, "LED%u on %llu us at t=%llu us, spec %u..%u ms", p->led + 1,
+                 (unsigned long long)on, (unsigned long long)p->start,
+                 BLINK_ON_MIN_US / 1000, BLINK_ON_MAX_US / 1000);
+        }
+        stat_add(&w->err, grid_residual(on, BLINK_ON_GRID_US));
+        if (i == 0) continue;
+
+        const pulse_t *q = &w->pulses[i - 1];
+        if (p->start < q->end) {
+            fail(w, "LED%u and LED%u lit together at t=%llu us", q->led + 1, p->led + 1,
+                 (unsigned long long)p->start);
+            continue;
+        }
+        if (p->led == q->led) {
+            fail(w, "LED%u blinked twice in a row at t=%llu us", p->led + 1,
+                 (unsigned long long)p->start);
+        }
+        uint64_t gap = p->start - q->end;
+        if (!in_range(gap, BLINK_GAP_MIN_US, BLINK_GAP_MAX_US, TOL_US)) {
+            fail(w, "gap %llu us at t=%llu us, spec %u..%u ms", (unsigned long long)gap,
+                 (unsigned long long)p->start, BLINK_GAP_MIN_US / 1000, BLINK_GAP_MAX_US / 1000);
+        }
+        stat_add(&w->err, grid_residual(gap, BLINK_GAP_GRID_US));
+    }
+}
+
+/* Ramp level of step k, rounded half away from zero like the engine */
+static uint32_t fade_level(uint32_t k) {
+    return 255U - (255U * k + FADE_STEPS / 2) / FADE_STEPS;
+}
+
+/* On-time of one LED in [t0, t1) */
+static uint64_t on_time(const window_t *w, size_t from, uint8_t led, uint64_t t0, uint64_t t1) {
+    uint64_t sum = 0;
+    for (size_t i = from; i < w->npulses && w->pulses[i].start < t1; i++) {
+        const pulse_t *p = &w->pulses[i];
+        if (p->led != led || p->end <= t0) continue;
+        sum += (p->end < t1 ? p->end : t1) - (p->start > t0 ? p->start : t0);
+    }
+    return sum;
+}
+
+static void check_fade(window_t *w) {
+    size_t i = 0;
+    int64_t last_end = -1;
+    int last_led = -1;
+
+    while (i < w->npulses) {
+        /* A fade starts with a full-brightness pulse */
+        const pulse_t *h = &w->pulses[i];
+        if (h->end - h->start < FADE_HOLD_US) {
+            if (last_end >= 0) {
+                fail(w, "LED%u stray pulse at t=%llu us", h->led + 1, (unsigned long long)h->start);
+            }
+            i++;
+            continue;
+        }
+        uint64_t t0 = h->start, ramp = t0 + FADE_HOLD_US;
+        uint64_t end = t0 + FADE_END_US;
+
+        if (last_end >= 0) {
+            uint64_t gap = t0 - (uint64_t)last_end;
+            if (!in_range(gap, FADE_GAP_MIN_US, FADE_GAP_MAX_US, TOL_US)) {
+                fail(w, "gap %llu us before fade at t=%llu us", (unsigned long long)gap,
+                     (unsigned long long)t0);
+            }
+            stat_add(&w->err, grid_residual(gap, BLINK_GAP_GRID_US));
+            if (h->led == last_led) {
+                fail(w, "LED%u faded twice in a row at t=%llu us", h->led + 1,
+                     (unsigned long long)t0);
+            }
+        }
+
+        /* Step 0 keeps full brightness, the first dimmed frame starts with step 1 */
+        uint64_t f0 = ramp + FADE_STEP_US;
+        int64_t err = (int64_t)(h->end - f0);
+        if (llabs(err) > TOL_US) {
+            fail(w, "LED%u full-on part %llu us, expected %u us", h->led + 1,
+                 (unsigned long long)(h->end - t0), FADE_HOLD_US + FADE_STEP_US);
+        }
+        stat_add(&w->err, err);
+
+        /* Every whole BCM frame carries the level of the step that was current
+           when the frame started (either one on a tie) */
+        for (uint64_t f = f0; f + BCM_FRAME_US <= end; f += BCM_FRAME_US) {
+            uint32_t k = (uint32_t)((f - ramp) / FADE_STEP_US);
+            bool tie = (f - ramp) % FADE_STEP_US < TOL_US && k > 1;
+            int64_t on = (int64_t)on_time(w, i, h->led, f, f + BCM_FRAME_US);
+            int64_t e = on - (int64_t)(fade_level(k) * BCM_BASE_US);
+            if (tie && llabs(on - (int64_t)(fade_level(k - 1) * BCM_BASE_US)) < llabs(e)) {
+                e = on - (int64_t)(fade_level(k - 1) * BCM_BASE_US);
+            }
+            if (llabs(e) > BCM_TOL_US) {
+                fail(w, "LED%u frame at t=%llu us: on %lld us, level %u expects %u us", h->led + 1,
+                     (unsigned long long)f, (long long)on, fade_level(k),
+                     fade_level(k) * BCM_BASE_US);
+            }
+            stat_add(&w->err, e);
+        }
+
+        /* Dark from the end of the ramp; other LEDs dark throughout */
+        size_t j = i + 1;
+        for (; j < w->npulses && w->pulses[j].start < end + TOL_US; j++) {
+            const pulse_t *p = &w->pulses[j];
+            if (p->led != h->led) {
+                fail(w, "LED%u lit during LED%u fade at t=%llu us", p->led + 1, h->led + 1,
+                     (unsigned long long)p->start);
+            } else if (p->end > end + TOL_US) {
+                fail(w, "LED%u still lit %llu us after the fade", p->led + 1,
+                     (unsigned long long)(p->end - end));
+            }
+        }
+        if (j == w->npulses && end > (uint64_t)w->end_ms * 1000U) break;   /* Window ended mid-fade */
+        last_end = (int64_t)end;
+        last_led = h->led;
+        i = j;
+    }
+}
+
+static const char *morse_for(char c) {
+    static const char *const letters[26] = {
+        ".-", "-...", "-.-.", "-..", ".", "..-.", "--.", "....", "..", ".---", "-.-", ".-..",
+        "--", "-.", "---", ".--.", "--.-", ".-.", "...", "-", "..-", "...-", ".--", "-..-",
+        "-.--", "--..",
+    };
+    static const char *const digits[10] = {
+        "-----", ".----", "..---", "...--", "....-", ".....", "-....", "--...", "---..", "----.",
+    };
+    if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+    if (c >= '0' && c <= '9') return digits[c - '0'];
+    if (c == '/') return "-..-.";
+    return NULL;
+}
+
+typedef struct {
+    bool dah;
+    uint8_t gap_units;      /* Off time before this element */
+} cw_element_t;
+
+static size_t cw_expected(cw_element_t *out, size_t max) {
+    size_t n = 0;
+    uint8_t gap = CW_REPEAT_GAP;
+    bool prosign = false;
+
+    for (const char *c = CW_MESSAGE; *c; c++) {
+        if (*c == '<' || *c == '>') {
+            /* Prosign: letters run together with element gaps */
+            prosign = (*c == '<');
+            continue;
+        }
+        const char *m = morse_for(*c);
+        if (!m) {
+            gap = CW_WORD_GAP;
+            continue;
+        }
+        for (; *m && n < max; m++) {
+            out[n++] = (cw_element_t){ *m == '-', gap };
+            gap = CW_ELEMENT_GAP;
+        }
+        gap = prosign ? CW_ELEMENT_GAP : CW_CHAR_GAP;
+    }
+    return n;
+}
+
+/* LEDs driven together must produce identical pulse trains */
+static void check_same_train(window_t *w, uint8_t ref, uint8_t led) {
+    size_t a = 0, b = 0;
+    for (;;) {
+        while (a < w->npulses && w->pulses[a].led != ref) a++;
+        while (b < w->npulses && w->pulses[b].led != led) b++;
+        if (a == w->npulses || b == w->npulses) break;
+        if (w->pulses[a].start != w->pulses[b].start || w->pulses[a].end != w->pulses[b].end) {
+            fail(w, "LED%u does not follow LED%u at t=%llu us", led + 1, ref + 1,
+                 (unsigned long long)w->pulses[a].start);
+            return;
+        }
+        a++;
+        b++;
+    }
+    if ((a == w->npulses) != (b == w->npulses)) {
+        fail(w, "LED%u and LED%u pulse counts differ", ref + 1, led + 1);
+    }
+}
+
+/* Element gaps run at the character speed, the longer gaps in spacing units */
+static int64_t cw_gap_us(const window_t *w, const cw_element_t *e) {
+    return (int64_t)e->gap_units * (e->gap_units == CW_ELEMENT_GAP ? w->unit_us : w->space_us);
+}
+
+static void check_cw(window_t *w) {
+    static cw_element_t exp[128];
+    size_t nexp = cw_expected(exp, sizeof(exp) / sizeof(exp[0]));
+    pulse_t *el = malloc((w->npulses + 1) * sizeof(pulse_t));
+    size_t nel = 0;
+
+    /* Dit lights LED1+LED5, dah LED2+LED3+LED4 */
+    check_same_train(w, 0, 4);
+    check_same_train(w, 1, 2);
+    check_same_train(w, 1, 3);
+    for (size_t i = 0; i < w->npulses; i++) {
+        if (w->pulses[i].led == 0 || w->pulses[i].led == 1) el[nel++] = w->pulses[i];
+    }
+    if (nel < nexp) {
+        fail(w, "only %zu elements in window, message has %zu", nel, nexp);
+        free(el);
+        return;
+    }
+
+    /* Find where in the message the window starts */
+    size_t best = 0, best_bad = (size_t)-1;
+    for (size_t k = 0; k < nexp; k++) {
+        size_t bad = 0;
+        for (size_t i = 0; i < nel; i++) {
+            const cw_element_t *e = &exp[(k + i) % nexp];
+            if ((el[i].led == 1) != e->dah) bad++;
+            else if (i && llabs((int64_t)(el[i].start - el[i - 1].end) - cw_gap_us(w, e)) >
+                          (int64_t)w->unit_us / 2) bad++;
+        }
+        if (bad < best_bad) {
+            best_bad = bad;
+            best = k;
+        }
+    }
+
+    for (size_t i = 0; i < nel; i++) {
+        const cw_element_t *e = &exp[(best + i) % nexp];
+        uint64_t on = el[i].end - el[i].start;
+        int64_t err_on = (int64_t)on - (int64_t)(e->dah ? CW_DAH_UNITS : CW_DIT_UNITS) * w->unit_us;
+
+        if ((el[i].led == 1) != e->dah) {
+            fail(w, "element %zu at t=%llu us is a %s, expected a %s", (best + i) % nexp,
+                 (unsigned long long)el[i].start, e->dah ? "dit" : "dah", e->dah ? "dah" : "dit");
+            continue;
+        }
+        if (llabs(err_on) > TOL_US) {
+            fail(w, "%s at t=%llu us lasts %llu us", e->dah ? "dah" : "dit",
+                 (unsigned long long)el[i].start, (unsigned long long)on);
+        }
+        stat_add(&w->err, err_on);
+        if (i == 0) continue;
+
+        uint64_t gap = el[i].start - el[i - 1].end;
+        int64_t err_gap = (int64_t)gap - cw_gap_us(w, e);
+        if (llabs(err_gap) > TOL_US) {
+            fail(w, "gap before element %zu at t=%llu us is %llu us, expected %u units",
+                 (best + i) % nexp, (unsigned long long)el[i].start, (unsigned long long)gap,
+                 e->gap_units);
+        }
+        stat_add(&w->err, err_gap);
+    }
+    free(el);
+}
+
+static void check_strobo(window_t *w) {
+    uint64_t flash_start = 0, flash_end = 0, prev_end = 0;
+
+    for (size_t i = 0; i < w->npulses; i++) {
+        const pulse_t *p = &w->pulses[i];
+        uint64_t on = p->end - p->start;
+
+        if (!in_range(on, STROBO_ON_MIN_US, STROBO_ON_MAX_US, TOL_US)) {
+            fail(w, "LED%u on %llu us at t=%llu us", p->led + 1, (unsigned long long)on,
+                 (unsigned long long)p->start);
+        }
+        if (p->start == flash_start && i) {
+            /* Another LED of the same flash */
+            if (p->end != flash_end) {
+                fail(w, "LED%u ends apart from its flash at t=%llu us", p->led + 1,
+                     (unsigned long long)p->start);
+            }
+            continue;
+        }
+        stat_add(&w->err, grid_residual(on, CHUNK_GRID_US));
+        prev_end = flash_end;
+        if (i && p->start < prev_end) {
+            fail(w, "flashes overlap at t=%llu us", (unsigned long long)p->start);
+        } else if (i && !in_range(p->start - prev_end, STROBO_GAP_MIN_US, STROBO_GAP_MAX_US, TOL_US)) {
+            fail(w, "gap %llu us before flash at t=%llu us",
+                 (unsigned long long)(p->start - prev_end), (unsigned long long)p->start);
+        }
+        flash_start = p->start;
+        flash_end = p->end;
+    }
+}
+
+static void check_widths(window_t *w, uint64_t min_us, uint64_t max_us) {
+    for (size_t i = 0; i < w->npulses; i++) {
+        const pulse_t *p = &w->pulses[i];
+        uint64_t on = p->end - p->start;
+
+        if (!in_range(on, min_us, max_us, TOL_US)) {
+            fail(w, "LED%u on %llu us at t=%llu us, spec %llu..%llu ms", p->led + 1,
+                 (unsigned long long)on, (unsigned long long)p->start,
+                 (unsigned long long)(min_us / 1000), (unsigned long long)(max_us / 1000));
+        }
+        stat_add(&w->err, grid_residual(on, CHUNK_GRID_US));
+    }
+}
+
+static void check_off(window_t *w) {
+    uint64_t w0 = (uint64_t)w->start_ms * 1000U, w1 = (uint64_t)w->end_ms * 1000U;
+    for (size_t i = 0; i < nedges; i++) {
+        if (edges[i].t_us >= w0 && edges[i].t_us <= w1) {
+            fail(w, "LED%u edge at t=%llu us", edges[i].led + 1, (unsigned long long)edges[i].t_us);
+        }
+    }
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [-l trace.csv] [-o results.txt] [-v]\n"
+        "  -l FILE   Also write the full LED edge trace (CSV)\n"
+        "  -o FILE   Write per-mode results as 'mode.key value' lines for comparing runs\n"
+        "  -v        Report every failure, not just the first %d per mode\n",
+        prog, MAX_REPORTED_FAILS);
+}
+
+int main(int argc, char **argv) {
+    const char *results = NULL;
+    char cmd[32];
+    int opt;
+    uint32_t total_fails = 0;
+
+    while ((opt = getopt(argc, argv, "l:o:vh")) != -1) {
+        switch (opt) {
+            case 'l':
+                sim_config.trace = fopen(optarg, "w");
+                if (!sim_config.trace) {
+                    perror(optarg);
+                    return 2;
+                }
+                fprintf(sim_config.trace, "t_us,pin,level\n");
+                break;
+            case 'o': results = optarg; break;
+            case 'v': verbose = true; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+
+    /* Fill in the fast CW window from its speeds */
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        window_t *w = &windows[i];
+        if (w->mode != 3 || w->unit_us) continue;
+        double c = CW_FAST_WPM, sp = CW_FAST_FARNSWORTH;
+        double ta_ms = (60.0 * c - 37.2 * sp) / (sp * c) * 1000.0;
+        w->unit_us = (uint32_t)llround(1200.0 / c) * 1000U;
+        w->space_us = (uint32_t)llround(ta_ms / 19.0) * 1000U;
+    }
+
+    /* Badge powered: full clock, brightness and LED count */
+    sim_add_event(0, SIM_EV_PWR, "1");
+    sim_add_event(1000000U, SIM_EV_SEND, "cw " CW_MESSAGE);
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        if (windows[i].setup) {
+            sim_add_event((uint64_t)(windows[i].switch_ms - 1000U) * 1000U, SIM_EV_SEND, windows[i].setup);
+        }
+        snprintf(cmd, sizeof(cmd), "bm %u", windows[i].mode);
+        sim_add_event((uint64_t)windows[i].switch_ms * 1000U, SIM_EV_SEND, cmd);
+    }
+    sim_config.end_us = (uint64_t)windows[WINDOW_COUNT - 1].end_ms * 1000U + 1000U;
+    sim_edge_hook = record_edge;
+
+    /* Firmware console output is not part of the result */
+    sim_config.uart_discard = true;
+
+    uint64_t host0 = host_now_ns();
+    int rc = sim_run();
+    double host_total_ms = (host_now_ns() - host0) / 1e6;
+    if (sim_config.trace) fclose(sim_config.trace);
+    if (rc != 0) {
+        printf("simulation exited with %d\n", rc);
+        return 1;
+    }
+
+    printf("LED timing conformance (%zu edges, %.1f s virtual, %.0f ms host)\n", nedges,
+           sim_now_us() / 1e6, host_total_ms);
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        window_t *w = &windows[i];
+        collect_pulses(w);
+        switch (w->mode) {
+            case 0: check_off(w); break;
+            case 1: check_blink(w); break;
+            case 2: check_fade(w); break;
+            case 3: check_cw(w); break;
+            case 4: check_strobo(w); break;
+            case 5: check_widths(w, ICIRCLE_ON_MIN_US, ICIRCLE_ON_MAX_US); break;
+            case 6: check_widths(w, DISCO_ON_MIN_US, DISCO_ON_MAX_US); break;
+        }
+        if (w->mode != 0 && w->npulses == 0) fail(w, "no LED activity");
+        total_fails += w->fails;
+    }
+
+    printf("\n%-8s %7s %8s %9s %9s %9s %9s %9s  %s\n", "mode", "pulses", "glitches",
+           "mean us", "jitter us", "min us", "max us", "host ms", "result");
+    for (size_t i = 0; i < WINDOW_COUNT; i++) {
+        const window_t *w = &windows[i];
+        printf("%-8s %7zu %8u %9.2f %9.2f %9lld %9lld %9.2f  %s\n", w->name, w->npulses,
+               w->glitches, stat_mean(&w->err), stat_sd(&w->err), (long long)w->err.min,
+               (long long)w->err.max, w->host_ms, w->fails ? "FAIL" : "ok");
+    }
+    printf("\nJitter is the deviation from nominal (CW, FADE) or from the mode's delay grid\n"
+           "(other modes). %s\n", total_fails ? "FAILED" : "All modes within spec.");
+
+    if (results) {
+        FILE *f = fopen(results, "w");
+        if (!f) {
+            perror(results);
+            return 2;
+        }
+        fprintf(f, "total.host_ms %.2f\n", host_total_ms);
+        for (size_t i = 0; i < WINDOW_COUNT; i++) {
+            const window_t *w = &windows[i];
+            fprintf(f, "%s.pulses %zu\n%s.glitches %u\n%s.mean_us %.2f\n%s.jitter_us %.2f\n"
+                       "%s.min_us %lld\n%s.max_us %lld\n%s.host_ms %.2f\n%s.fails %u\n",
+                    w->name, w->npulses, w->name, w->glitches, w->name, stat_mean(&w->err),
+                    w->name, stat_sd(&w->err), w->name, (long long)w->err.min, w->name,
+                    (long long)w->err.max, w->name, w->host_ms, w->name, w->fails);
+        }
+        fclose(f);
+    }
+    return total_fails ? 1 : 0;
+}
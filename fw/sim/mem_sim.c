@@ -0,0 +1,10 @@
+/* Simulated RAM checks: the host process has no stack to paint */
+
+#include "mem.h"
+
+void mem_paint(void) {
+}
+
+bool mem_check(void) {
+    return true;
+}
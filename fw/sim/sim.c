@@ -0,0 +1,370 @@
+/* Host simulation core
+ *
+ * Virtual time only moves when the firmware waits (delay_us/delay_ms), sends on
+ * the UART or talks to a peripheral, so a scenario covering minutes of badge
+ * time runs in milliseconds. Scenario events are applied at their exact virtual
+ * timestamps from inside sim_advance(), which is where interrupts would fire on
+ * the real part.
+ */
+
+#define _GNU_SOURCE
+#include "sim.h"
+#include "pins.h"
+#include "gpio.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <setjmp.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+
+sim_config_t sim_config;
+sim_stats_t sim_stats;
+sim_edge_hook_t sim_edge_hook;
+
+typedef struct {
+    uint64_t t_us;
+    sim_event_type_t type;
+    char *arg;
+} sim_event_t;
+
+static sim_event_t *events;
+static size_t ev_count, ev_cap, ev_next;
+
+static uint64_t now_us;
+static uint64_t timer_at[SIM_TIMERS];
+static sim_timer_fn_t timer_fn[SIM_TIMERS];
+static jmp_buf run_jmp;
+static int exit_code;
+static bool running;
+
+/* UART output, for the expect and reject events */
+static char *transcript;
+static size_t tr_len, tr_cap, tr_mark;
+
+/* LED1..LED5 levels, for the maxlit event. A state counts once virtual time
+   has passed in it, not between the port writes of one frame. */
+static uint8_t lit_mask, lit_max;
+static uint64_t lit_since;
+
+static int pty_master = -1;
+static int pty_slave = -1;
+static struct timespec wall_start;
+
+uint64_t sim_now_us(void) {
+    return now_us;
+}
+
+int sim_add_event(uint64_t t_us, sim_event_type_t type, const char *arg) {
+    if (ev_count == ev_cap) {
+        size_t cap = ev_cap ? ev_cap * 2 : 64;
+        sim_event_t *p = realloc(events, cap * sizeof(*p));
+        if (!p) return -1;
+        events = p;
+        ev_cap = cap;
+    }
+    /* Keep the list sorted; equal timestamps stay in insertion order */
+    size_t i = ev_count;
+    while (i > ev_next && events[i - 1].t_us > t_us) {
+        events[i] = events[i - 1];
+        i--;
+    }
+    events[i].t_us = t_us;
+    events[i].type = type;
+    events[i].arg = arg ? strdup(arg) : NULL;
+    ev_count++;
+    return 0;
+}
+
+/* Script format, one event per line ('#' starts a comment):
+ *   <ms> send <text>   <ms> raw <text>   <ms> press   <ms> release
+ *   <ms> click         <ms> pwr <0|1>    <ms> end
+ *   <ms> expect <text> <ms> reject <text>  <ms> maxlit <n>
+ */
+int sim_load_script(const char *path) {
+    static const struct { const char *name; sim_event_type_t type; } verbs[] = {
+        { "send", SIM_EV_SEND }, { "raw", SIM_EV_RAW }, { "press", SIM_EV_PRESS },
+        { "release", SIM_EV_RELEASE }, { "click", SIM_EV_CLICK }, { "pwr", SIM_EV_PWR },
+        { "expect", SIM_EV_EXPECT }, { "reject", SIM_EV_REJECT },
+        { "maxlit", SIM_EV_MAXLIT }, { "end", SIM_EV_END },
+    };
+    FILE *f = fopen(path, "r");
+    char line[256];
+    unsigned lineno = 0;
+
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    while (fgets(line, sizeof(line), f)) {
+        char *p = line, *end;
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        while (isspace((unsigned char)*p)) p++;
+        if (*p == '\0' || *p == '#') continue;
+
+        double ms = strtod(p, &end);
+        if (end == p) goto bad;
+        p = end;
+        while (isspace((unsigned char)*p)) p++;
+
+        size_t vlen = strcspn(p, " \t");
+        const char *arg = p + vlen;
+        while (*arg == ' ' || *arg == '\t') arg++;
+
+        size_t v;
+        for (v = 0; v < sizeof(verbs) / sizeof(verbs[0]); v++) {
+            if (strlen(verbs[v].name) == vlen && strncmp(p, verbs[v].name, vlen) == 0) break;
+        }
+        if (v == sizeof(verbs) / sizeof(verbs[0])) goto bad;
+        sim_add_event((uint64_t)(ms * 1000.0), verbs[v].type, arg);
+        continue;
+bad:
+        fprintf(stderr, "%s:%u: cannot parse '%s'\n", path, lineno, line);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    return 0;
+}
+
+/* expect: the text must be in the UART output after the last match, which
+   then moves past it. reject: the text must not be there. */
+static void sim_check(const sim_event_t *e) {
+    const char *text = e->arg ? e->arg : "";
+    const char *found = transcript ? strstr(transcript + tr_mark, text) : NULL;
+
+    if (e->type == SIM_EV_EXPECT && found) {
+        tr_mark = (size_t)(found - transcript) + strlen(text);
+        return;
+    }
+    if (e->type == SIM_EV_REJECT && !found) return;
+    sim_stats.expect_failures++;
+    fprintf(stderr, "[sim] %.3f s: %s '%s' failed\n", e->t_us / 1e6,
+            e->type == SIM_EV_EXPECT ? "expect" : "reject", text);
+}
+
+static void lit_account(void) {
+    if (now_us > lit_since) {
+        uint8_t n = (uint8_t)__builtin_popcount(lit_mask);
+        if (n > lit_max) lit_max = n;
+        lit_since = now_us;
+    }
+}
+
+static void sim_check_lit(const sim_event_t *e) {
+    unsigned n = e->arg ? (unsigned)strtoul(e->arg, NULL, 10) : 0;
+
+    lit_account();
+    if (lit_max > n) {
+        sim_stats.expect_failures++;
+        fprintf(stderr, "[sim] %.3f s: maxlit %u failed, %u LEDs lit at once\n", e->t_us / 1e6,
+                n, lit_max);
+    }
+    lit_max = (uint8_t)__builtin_popcount(lit_mask);
+}
+
+static void sim_apply(const sim_event_t *e) {
+    switch (e->type) {
+        case SIM_EV_SEND:
+        case SIM_EV_RAW:
+            for (const char *c = e->arg; c && *c; c++) sim_uart_rx((uint8_t)*c);
+            if (e->type == SIM_EV_SEND) sim_uart_rx('\r');
+            break;
+        case SIM_EV_PRESS:
+            sim_gpio_drive(BTN_GPIO_PORT, BTN_GPIO_PIN, 0);
+            break;
+        case SIM_EV_RELEASE:
+            sim_gpio_drive(BTN_GPIO_PORT, BTN_GPIO_PIN, -1);
+            break;
+        case SIM_EV_CLICK:
+            sim_gpio_drive(BTN_GPIO_PORT, BTN_GPIO_PIN, 0);
+            sim_add_event(e->t_us + SIM_CLICK_MS * 1000U, SIM_EV_RELEASE, NULL);
+            break;
+        case SIM_EV_PWR:
+            sim_gpio_drive(BADGE_PWR_SENSE_GPIO_PORT, BADGE_PWR_SENSE_GPIO_PIN,
+                           (e->arg && e->arg[0] == '1') ? 1 : 0);
+            break;
+        case SIM_EV_EXPECT:
+        case SIM_EV_REJECT:
+            sim_check(e);
+            break;
+        case SIM_EV_MAXLIT:
+            sim_check_lit(e);
+            break;
+        case SIM_EV_END:
+            sim_stop(0);
+            break;
+    }
+}
+
+static void sim_poll_input(void) {
+    int fd = sim_config.pty_uart ? pty_master : (sim_config.stdin_uart ? STDIN_FILENO : -1);
+    uint8_t buf[64];
+    ssize_t n;
+
+    if (fd < 0) return;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < n; i++) sim_uart_rx(buf[i]);
+    }
+    if (n == 0 && fd == STDIN_FILENO) sim_config.stdin_uart = false;  /* EOF */
+}
+
+static void sim_pace(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    uint64_t wall_us = (uint64_t)(now.tv_sec - wall_start.tv_sec) * 1000000U +
+                       (uint64_t)((now.tv_nsec - wall_start.tv_nsec) / 1000);
+    if (now_us > wall_us + 1000U) {
+        uint64_t d = now_us - wall_us;
+        struct timespec ts = { (time_t)(d / 1000000U), (long)(d % 1000000U) * 1000L };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void sim_timer_set(sim_timer_id_t id, uint64_t at_us, sim_timer_fn_t fn) {
+    timer_at[id] = at_us;
+    timer_fn[id] = fn;
+}
+
+void sim_timer_cancel(sim_timer_id_t id) {
+    timer_fn[id] = NULL;
+}
+
+void sim_wait_irq(void) {
+    uint64_t at = UINT64_MAX;
+
+    for (int i = 0; i < SIM_TIMERS; i++) {
+        if (timer_fn[i] && timer_at[i] < at) at = timer_at[i];
+    }
+    if (ev_next < ev_count && events[ev_next].t_us < at) at = events[ev_next].t_us;
+    /* Input from stdin or the pty is polled: look again after a millisecond */
+    if (at > now_us + 1000U && (sim_config.stdin_uart || sim_config.pty_uart)) at = now_us + 1000U;
+    if (at < now_us) at = now_us;
+    if (at - now_us > UINT32_MAX) at = now_us + UINT32_MAX;
+    sim_advance((uint32_t)(at - now_us));
+}
+
+void sim_advance(uint32_t us) {
+    uint64_t target = now_us + us;
+
+    for (;;) {
+        bool ev = ev_next < ev_count && events[ev_next].t_us <= target;
+        int tim = -1;
+
+        for (int i = 0; i < SIM_TIMERS; i++) {
+            if (timer_fn[i] && timer_at[i] <= target && (tim < 0 || timer_at[i] < timer_at[tim])) tim = i;
+        }
+        if (tim >= 0 && (!ev || timer_at[tim] <= events[ev_next].t_us)) {
+            /* The interrupt handler may re-arm the timer */
+            sim_timer_fn_t fn = timer_fn[tim];
+            if (timer_at[tim] > now_us) now_us = timer_at[tim];
+            timer_fn[tim] = NULL;
+            fn();
+        } else if (ev) {
+            sim_event_t e = events[ev_next++];
+            if (e.t_us > now_us) now_us = e.t_us;
+            sim_apply(&e);
+            free(e.arg);
+        } else {
+            break;
+        }
+    }
+    if (sim_config.end_us && target >= sim_config.end_us) {
+        now_us = sim_config.end_us;
+        sim_stop(0);
+    }
+    now_us = target;
+
+    sim_poll_input();
+    if (sim_config.realtime) sim_pace();
+}
+
+void sim_uart_output(uint8_t c) {
+    if (tr_len + 2U > tr_cap) {
+        size_t cap = tr_cap ? tr_cap * 2U : 4096U;
+        char *p = realloc(transcript, cap);
+        if (p) {
+            transcript = p;
+            tr_cap = cap;
+        }
+    }
+    if (tr_len + 2U <= tr_cap && c != '\0') {
+        transcript[tr_len++] = (char)c;
+        transcript[tr_len] = '\0';
+    }
+    if (sim_config.uart_discard) return;
+    if (pty_master >= 0) {
+        (void)!write(pty_master, &c, 1);
+    } else {
+        putchar(c);
+    }
+}
+
+void sim_led_edge(const char *pin, uint8_t level) {
+    sim_stats.led_edges++;
+    if (strncmp(pin, "LED", 3) == 0 && pin[3] >= '1' && pin[3] <= '5') {
+        lit_account();
+        uint8_t bit = (uint8_t)(1U << (pin[3] - '1'));
+        lit_mask = level ? (uint8_t)(lit_mask | bit) : (uint8_t)(lit_mask & ~bit);
+    }
+    if (sim_config.trace) {
+        fprintf(sim_config.trace, "%llu,%s,%u\n", (unsigned long long)now_us, pin, level);
+    }
+    if (sim_edge_hook) sim_edge_hook(now_us, pin, level);
+}
+
+static int sim_open_pty(void) {
+    struct termios tio;
+
+    pty_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty_master < 0 || grantpt(pty_master) != 0 || unlockpt(pty_master) != 0) {
+        perror("pty");
+        return -1;
+    }
+    /* Keep the slave open so the master never sees EIO between clients */
+    pty_slave = open(ptsname(pty_master), O_RDWR | O_NOCTTY);
+    if (pty_slave >= 0 && tcgetattr(pty_slave, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(pty_slave, TCSANOW, &tio);
+    }
+    fcntl(pty_master, F_SETFL, O_NONBLOCK);
+    fprintf(stderr, "[sim] UART on %s\n", ptsname(pty_master));
+    return 0;
+}
+
+void sim_stop(int code) {
+    exit_code = code;
+    if (running) longjmp(run_jmp, 1);
+    exit(code);
+}
+
+int sim_run(void) {
+    if (sim_config.pty_uart && sim_open_pty() != 0) return 1;
+    if (sim_config.stdin_uart) fcntl(STDIN_FILENO, F_SETFL, O_NONBLOCK);
+    clock_gettime(CLOCK_MONOTONIC, &wall_start);
+
+    sim_gpio_init();
+
+    /* Events at t=0 (e.g. button held at power-on) apply before boot */
+    sim_advance(0);
+
+    if (setjmp(run_jmp) == 0) {
+        running = true;
+        firmware_main();
+    }
+    running = false;
+    fflush(stdout);
+    if (sim_config.trace) fflush(sim_config.trace);
+
+    /* Checks after a reset or the time limit see the output up to there */
+    for (size_t i = ev_next; i < ev_count; i++) {
+        if (events[i].type == SIM_EV_EXPECT || events[i].type == SIM_EV_REJECT) sim_check(&events[i]);
+        if (events[i].type == SIM_EV_MAXLIT) sim_check_lit(&events[i]);
+    }
+    if (exit_code == 0 && sim_stats.expect_failures) exit_code = 1;
+    return exit_code;
+}
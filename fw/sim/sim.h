@@ -0,0 +1,99 @@
+/* Host simulation core: virtual time, scenario events and peripheral hooks */
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+/* Scenario event types */
+typedef enum {
+    SIM_EV_SEND = 0,    /* Type text followed by CR on the UART */
+    SIM_EV_RAW,         /* Type text as-is */
+    SIM_EV_PRESS,       /* Button down (PA2 driven low) */
+    SIM_EV_RELEASE,     /* Button up */
+    SIM_EV_CLICK,       /* Press, release after SIM_CLICK_MS */
+    SIM_EV_PWR,         /* BADGE_PWR_SENSE level (arg "0"/"1") */
+    SIM_EV_EXPECT,      /* UART output since the last match contains arg */
+    SIM_EV_REJECT,      /* UART output since the last match lacks arg */
+    SIM_EV_MAXLIT,      /* At most arg LED1..LED5 lit at once since the last one */
+    SIM_EV_END          /* Stop the simulation */
+} sim_event_type_t;
+
+#define SIM_CLICK_MS    100U
+
+typedef struct {
+    uint64_t led_edges;
+    uint64_t uart_tx;
+    uint64_t uart_rx;
+    uint64_t uart_rx_overruns;
+    uint64_t eeprom_bytes_written;
+    uint64_t eeprom_write_cycles;
+    uint64_t eeprom_busy_naks;
+    uint64_t flash_erases;
+    uint64_t flash_programs;
+    uint64_t expect_failures;
+} sim_stats_t;
+
+typedef struct {
+    uint64_t end_us;            /* 0 = run until an 'end' event */
+    bool realtime;              /* Pace virtual time to the wall clock */
+    bool stdin_uart;            /* Feed stdin into UART RX */
+    bool pty_uart;              /* Expose the UART on a pseudo terminal */
+    bool uart_discard;          /* Drop UART output (test runs) */
+    bool eeprom_absent;         /* No 24C02 fitted: every access NACKs */
+    FILE *trace;                /* LED edge trace (CSV), may be NULL */
+} sim_config_t;
+
+extern sim_config_t sim_config;
+extern sim_stats_t sim_stats;
+
+/* Optional in-process observer for LED edges (tests) */
+typedef void (*sim_edge_hook_t)(uint64_t t_us, const char *pin, uint8_t level);
+extern sim_edge_hook_t sim_edge_hook;
+
+/* Virtual time */
+uint64_t sim_now_us(void);
+void sim_advance(uint32_t us);
+
+/* Hardware timer interrupts: fn runs at virtual time at_us, from inside
+   sim_advance() in time order with the scenario events (timers first, lower
+   id first, on a tie). One pending interrupt per timer. */
+typedef enum {
+    SIM_TIMER_TIM14 = 0,    /* BCM planes */
+    SIM_TIMER_TIM17,        /* CW keying */
+    SIM_TIMER_SYSTICK,      /* 1 ms system tick */
+    SIM_TIMER_TIM16,        /* Main loop wake-up */
+    SIM_TIMERS
+} sim_timer_id_t;
+typedef void (*sim_timer_fn_t)(void);
+void sim_timer_set(sim_timer_id_t id, uint64_t at_us, sim_timer_fn_t fn);
+void sim_timer_cancel(sim_timer_id_t id);
+/* WFI: advance to the next timer interrupt or scenario event */
+void sim_wait_irq(void);
+
+/* Scenario */
+int sim_add_event(uint64_t t_us, sim_event_type_t type, const char *arg);
+int sim_load_script(const char *path);
+
+/* Run firmware_main() until an 'end' event, the time limit or a reset.
+   Returns the exit code passed to sim_stop(), or 1 if an expect or reject
+   event failed; those after the end of the run check the output so far. */
+int sim_run(void);
+void sim_stop(int code);
+
+/* Peripheral model hooks */
+void sim_uart_output(uint8_t c);
+void sim_uart_rx(uint8_t c);
+void sim_gpio_init(void);
+void sim_gpio_drive(void *port, uint8_t pin, int level);   /* level -1 = release */
+void sim_led_edge(const char *pin, uint8_t level);
+int sim_eeprom_load(const char *path);
+int sim_eeprom_save(const char *path);
+int sim_flash_load(const char *path);
+int sim_flash_save(const char *path);
+
+/* Firmware entry point (main() in src/main.c, renamed for the host build) */
+int firmware_main(void);
+
+#endif /* SIM_H */
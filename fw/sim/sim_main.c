@@ -0,0 +1,90 @@
+/* Host simulation entry point
+ *
+ *   SRAL-SAO2-sim [options] [script]
+ *
+ * Runs the unmodified firmware main loop against simulated peripherals. UART
+ * output goes to stdout (or a pseudo terminal with -p), LED edges to a CSV trace.
+ */
+
+#include "sim.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+        "Usage: %s [options] [script]\n"
+        "  -s FILE   Scenario script (same as positional argument)\n"
+        "  -t MS     Stop after MS of virtual time (default 10000, 0 = no limit)\n"
+        "  -l FILE   Write LED edge trace (CSV: t_us,pin,level)\n"
+        "  -e FILE   EEPROM image (loaded at start, saved at exit)\n"
+        "  -E        No EEPROM fitted (exercises the flash storage fallback)\n"
+        "  -f FILE   Flash emulation image (loaded at start, saved at exit)\n"
+        "  -i        Feed stdin to the UART (implies -r, no time limit)\n"
+        "  -p        Expose the UART on a pseudo terminal (implies -r, no time limit)\n"
+        "  -r        Run in real time instead of as fast as possible\n"
+        "  -q        Do not print the run summary\n",
+        prog);
+}
+
+int main(int argc, char **argv) {
+    const char *script = NULL, *trace = NULL, *eeprom = NULL, *flash = NULL;
+    long limit_ms = -1;
+    bool quiet = false;
+    int opt, rc;
+
+    while ((opt = getopt(argc, argv, "s:t:l:e:Ef:iprqh")) != -1) {
+        switch (opt) {
+            case 's': script = optarg; break;
+            case 't': limit_ms = strtol(optarg, NULL, 0); break;
+            case 'l': trace = optarg; break;
+            case 'e': eeprom = optarg; break;
+            case 'E': sim_config.eeprom_absent = true; break;
+            case 'f': flash = optarg; break;
+            case 'i': sim_config.stdin_uart = true; sim_config.realtime = true; break;
+            case 'p': sim_config.pty_uart = true; sim_config.realtime = true; break;
+            case 'r': sim_config.realtime = true; break;
+            case 'q': quiet = true; break;
+            default: usage(argv[0]); return (opt == 'h') ? 0 : 2;
+        }
+    }
+    if (optind < argc) script = argv[optind];
+
+    if (limit_ms < 0) limit_ms = (sim_config.stdin_uart || sim_config.pty_uart) ? 0 : 10000;
+    sim_config.end_us = (uint64_t)limit_ms * 1000U;
+
+    if (script && sim_load_script(script) != 0) return 2;
+    if (trace) {
+        sim_config.trace = fopen(trace, "w");
+        if (!sim_config.trace) {
+            perror(trace);
+            return 2;
+        }
+        fprintf(sim_config.trace, "t_us,pin,level\n");
+    }
+    if (eeprom) sim_eeprom_load(eeprom);
+    if (flash) sim_flash_load(flash);
+
+    rc = sim_run();
+
+    if (eeprom && sim_eeprom_save(eeprom) != 0) perror(eeprom);
+    if (flash && sim_flash_save(flash) != 0) perror(flash);
+    if (sim_config.trace) fclose(sim_config.trace);
+
+    if (!quiet) {
+        fprintf(stderr,
+            "\n[sim] %.3f s virtual time\n"
+            "[sim] LED edges %llu, UART tx %llu rx %llu (overruns %llu)\n"
+            "[sim] EEPROM %llu B in %llu write cycles, %llu busy NAKs\n"
+            "[sim] flash %llu page erases, %llu double-word programs\n",
+            sim_now_us() / 1e6,
+            (unsigned long long)sim_stats.led_edges, (unsigned long long)sim_stats.uart_tx,
+            (unsigned long long)sim_stats.uart_rx, (unsigned long long)sim_stats.uart_rx_overruns,
+            (unsigned long long)sim_stats.eeprom_bytes_written,
+            (unsigned long long)sim_stats.eeprom_write_cycles,
+            (unsigned long long)sim_stats.eeprom_busy_naks,
+            (unsigned long long)sim_stats.flash_erases, (unsigned long long)sim_stats.flash_programs);
+    }
+    return rc;
+}
@@ -0,0 +1,25 @@
+/* Host stand-in for the CMSIS device header (simulation build only).
+ * Provides the GPIO port handles used by pins.h and nothing else, so any
+ * direct register access left in the portable modules fails to compile.
+ */
+#ifndef SIM_STM32C011XX_H
+#define SIM_STM32C011XX_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t MODER;
+    uint32_t OTYPER;
+    uint32_t OSPEEDR;
+    uint32_t PUPDR;
+    uint32_t IDR;
+    uint32_t ODR;
+} GPIO_TypeDef;
+
+extern GPIO_TypeDef sim_gpio[3];
+
+#define GPIOA (&sim_gpio[0])
+#define GPIOB (&sim_gpio[1])
+#define GPIOC (&sim_gpio[2])
+
+#endif /* SIM_STM32C011XX_H */
@@ -0,0 +1,57 @@
+/* Simulated system control */
+
+#include "system.h"
+#include "config.h"
+#include "sim.h"
+#include "uart.h"
+#include "log.h"
+#include "trace.h"
+
+static uint32_t sysclk_hz = SYSTEM_CLOCK_HZ;
+static uint8_t clock_profile = CLOCK_ECO;
+
+void System_ClockConfig(void) {
+}
+
+uint32_t System_GetClock(void) {
+    return sysclk_hz;
+}
+
+/* Timers run from virtual time; only the UART baud rate limits follow the clock */
+int System_SetClockProfile(uint8_t profile) {
+    if (profile >= CLOCK_PROFILES) return -1;
+    if (profile == clock_profile) return 0;
+    clock_profile = profile;
+    sysclk_hz = (profile == CLOCK_PERF) ? SYSTEM_CLOCK_PERF_HZ : SYSTEM_CLOCK_HZ;
+    UART_ClockUpdate();
+    trace(TRACE_CLOCK, profile, (uint16_t)(sysclk_hz / 1000000U));
+    LOG("clock: profile %u, %u Hz", profile, sysclk_hz);
+    return 0;
+}
+
+uint8_t System_GetClockProfile(void) {
+    return clock_profile;
+}
+
+const char *System_ClockProfileName(uint8_t profile) {
+    return profile == CLOCK_PERF ? "perf" : "eco";
+}
+
+void System_Init(void) {
+    System_ClockConfig();
+}
+
+void System_Sleep(void) {
+    sim_wait_irq();
+}
+
+void System_Reset(void) {
+    fprintf(stderr, "[sim] system reset requested\n");
+    sim_stop(0);
+}
+
+void System_EnterBootloader(void) {
+    fprintf(stderr, "[sim] reset into the bootloader requested%s\n",
+            uart2_enabled ? ", USART2 too" : "");
+    sim_stop(0);
+}
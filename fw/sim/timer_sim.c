@@ -0,0 +1,108 @@
+/* Simulated timebase: delays advance virtual time */
+
+#include "timer.h"
+#include "gpio.h"
+#include "pins.h"
+#include "sim.h"
+#include "bcm.h"
+#include "pattern.h"
+#include "button.h"
+#include "event.h"
+#include "watchdog.h"
+
+/* SysTick model: 1 ms tick for the button debouncer */
+static uint64_t systick_next;
+
+static void systick_irq(void) {
+    button_tick((uint32_t)(systick_next / 1000U));
+    watchdog_tick();
+    systick_next += 1000U;
+    sim_timer_set(SIM_TIMER_SYSTICK, systick_next, systick_irq);
+}
+
+void Timer_Init(void) {
+    systick_next = sim_now_us() + 1000U;
+    sim_timer_set(SIM_TIMER_SYSTICK, systick_next, systick_irq);
+}
+
+void delay_us(uint32_t us) {
+    sim_advance(us);
+}
+
+void delay_ms(uint32_t ms) {
+    sim_advance(ms * 1000U);
+}
+
+uint32_t micros(void) {
+    /* Reading the timer costs time too; also guarantees polling loops progress */
+    sim_advance(1);
+    return (uint32_t)sim_now_us();
+}
+
+void PWM_Init(void) {
+    GPIO_SetMode(LED1_GPIO_PORT, LED1_GPIO_PIN, GPIO_MODE_OUTPUT);
+    GPIO_SetMode(LED2_GPIO_PORT, LED2_GPIO_PIN, GPIO_MODE_OUTPUT);
+    GPIO_SetMode(LED3_GPIO_PORT, LED3_GPIO_PIN, GPIO_MODE_OUTPUT);
+    GPIO_SetMode(LED4_GPIO_PORT, LED4_GPIO_PIN, GPIO_MODE_OUTPUT);
+    GPIO_SetMode(LED5_GPIO_PORT, LED5_GPIO_PIN, GPIO_MODE_OUTPUT);
+}
+
+void PWM_SetDutyCycle(uint8_t channel, uint8_t duty_cycle) {
+    if (channel >= 1 && channel <= BCM_LEDS) BCM_SetLevel(channel - 1, duty_cycle);
+}
+
+/* TIM14 model for the BCM driver: update interrupt at the end of each
+   period, ARR preloaded one period ahead */
+static uint64_t tim14_update;
+static uint16_t tim14_arr_next;
+
+static void tim14_irq(void) {
+    uint16_t period = tim14_arr_next;
+    tim14_arr_next = BCM_NextPlane();
+    tim14_update += period;
+    sim_timer_set(SIM_TIMER_TIM14, tim14_update, tim14_irq);
+}
+
+void BCM_TimerStart(uint16_t first_us, uint16_t next_us) {
+    tim14_update = sim_now_us() + first_us;
+    tim14_arr_next = next_us;
+    sim_timer_set(SIM_TIMER_TIM14, tim14_update, tim14_irq);
+}
+
+void BCM_TimerStop(void) {
+    sim_timer_cancel(SIM_TIMER_TIM14);
+}
+
+/* TIM17 model for CW keying: 1 kHz counter, compare interrupt, CCR1
+   advanced by the handler */
+static uint64_t tim17_match;
+
+static void tim17_irq(void) {
+    uint16_t next_ms = pattern_cw_next();
+    if (!next_ms) return;
+    tim17_match += (uint64_t)next_ms * 1000U;
+    sim_timer_set(SIM_TIMER_TIM17, tim17_match, tim17_irq);
+}
+
+void CW_TimerStart(uint16_t first_ms) {
+    tim17_match = sim_now_us() + (uint64_t)first_ms * 1000U;
+    sim_timer_set(SIM_TIMER_TIM17, tim17_match, tim17_irq);
+}
+
+void CW_TimerStop(void) {
+    sim_timer_cancel(SIM_TIMER_TIM17);
+}
+
+/* TIM16 model for the main loop wake-up: one-pulse update interrupt */
+static void tim16_irq(void) {
+    event_post(EVENT_TIMER, EVENT_SRC_WAKE, 0, (uint32_t)sim_now_us());
+}
+
+void Wake_TimerStart(uint16_t us) {
+    if (us == 0) us = 1;
+    sim_timer_set(SIM_TIMER_TIM16, sim_now_us() + us, tim16_irq);
+}
+
+void Wake_TimerStop(void) {
+    sim_timer_cancel(SIM_TIMER_TIM16);
+}
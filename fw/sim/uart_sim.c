@@ -0,0 +1,89 @@
+/* Simulated USART1/USART2: stdout or pty output, RX ring fed by the sim core */
+
+#include "uart.h"
+#include "config.h"
+#include "system.h"
+#include "sim.h"
+#include "event.h"
+#include "log.h"
+#include "trace.h"
+
+bool uart2_enabled = false;
+
+static uint32_t uart_baud = UART_BAUDRATE;
+/* One 8N1 character on the wire, the time a blocking send costs */
+static uint32_t uart_char_us = (10U * 1000000U) / UART_BAUDRATE;
+
+static uint8_t uart_rx_buffer[UART_RX_BUFFER_SIZE];
+static uint32_t uart_rx_head = 0;
+static uint32_t uart_rx_tail = 0;
+
+void UART_Init(void) {
+}
+
+void UART2_Init(void) {
+    uart2_enabled = true;
+}
+
+void UART_SendChar(char c) {
+    sim_stats.uart_tx++;
+    sim_uart_output((uint8_t)c);
+    sim_advance(uart_char_us);
+}
+
+void UART_Flush(void) {
+}
+
+int UART_SetBaud(uint32_t baud) {
+    if (baud == 0) return -1;
+    uint32_t brr = (System_GetClock() + baud / 2U) / baud;
+    if (brr < 16U || brr > 0xFFFFU) return -1;
+    uart_baud = baud;
+    uart_char_us = (10U * 1000000U) / baud;
+    return 0;
+}
+
+uint32_t UART_GetBaud(void) {
+    return uart_baud;
+}
+
+void UART_ClockUpdate(void) {
+    if (UART_SetBaud(uart_baud) != 0) UART_SetBaud(UART_BAUDRATE);
+}
+
+void UART_SendString(const char *str) {
+    while (*str) UART_SendChar(*str++);
+}
+
+void UART_SendData(const uint8_t *data, uint32_t len) {
+    for (uint32_t i = 0; i < len; i++) UART_SendChar(data[i]);
+}
+
+int UART_ReceiveChar(char *c) {
+    if (uart_rx_head == uart_rx_tail) return 0;
+    *c = uart_rx_buffer[uart_rx_tail];
+    uart_rx_tail = (uart_rx_tail + 1) % UART_RX_BUFFER_SIZE;
+    return 1;
+}
+
+uint32_t UART_Available(void) {
+    return (uart_rx_head - uart_rx_tail + UART_RX_BUFFER_SIZE) % UART_RX_BUFFER_SIZE;
+}
+
+void UART_IRQHandler(void) {
+}
+
+/* Equivalent of the RXNE interrupt: drops the byte when the ring is full */
+void sim_uart_rx(uint8_t c) {
+    uint32_t next = (uart_rx_head + 1) % UART_RX_BUFFER_SIZE;
+    sim_stats.uart_rx++;
+    if (next == uart_rx_tail) {
+        sim_stats.uart_rx_overruns++;
+        trace(TRACE_UART_OVERRUN, 1, 0);
+        LOG("uart%u: rx overrun", 1);
+        return;
+    }
+    uart_rx_buffer[uart_rx_head] = c;
+    if (uart_rx_head == uart_rx_tail) event_post(EVENT_UART_RX, 1, c, (uint32_t)sim_now_us());
+    uart_rx_head = next;
+}
@@ -0,0 +1,98 @@
+/* Binary code modulation driver for LED1..LED5
+ *
+ * Most LED pins have no timer channel, so all five LEDs are dimmed by one
+ * timer instead: at each of the 8 plane boundaries per frame the interrupt
+ * writes the plane's LED mask with led_write_mask(), one precomputed BSRR word
+ * per port. The CPU cost is fixed and does not depend on the levels. Frames
+ * are double buffered, a new set of levels is swapped in at the start of a
+ * frame.
+ */
+
+#include "bcm.h"
+#include "led.h"
+#include "config.h"
+#include <stdbool.h>
+
+static uint8_t levels[BCM_LEDS];    /* As set, before the scale */
+static uint8_t lit[BCM_LEDS];       /* Output levels */
+static uint8_t scale = 255;
+static volatile uint8_t planes[2][BCM_PLANES];  /* LED mask lit in each plane */
+static volatile uint8_t shown;      /* Buffer the interrupt outputs */
+static volatile bool swap;          /* The other buffer holds a newer frame */
+static uint8_t plane;               /* Plane being output */
+static bool running;
+
+/* LEDs whose level has the given bit set */
+static uint8_t plane_mask(uint8_t bit) {
+    uint8_t m = 0;
+    for (uint8_t i = 0; i < BCM_LEDS; i++) {
+        if (lit[i] & (1U << bit)) m |= (uint8_t)(1U << i);
+    }
+    return m;
+}
+
+void BCM_SetLevels(const uint8_t *lv) {
+    bool dim = false;
+
+    for (uint8_t i = 0; i < BCM_LEDS; i++) {
+        levels[i] = lv[i];
+        /* Rounded up: a lit LED stays lit at any scale above 0 */
+        lit[i] = (uint8_t)((lv[i] * scale + 254U) / 255U);
+        if (lit[i] != 0 && lit[i] != 255) dim = true;
+    }
+
+    if (!dim) {
+        /* Every plane is the same: write it once, no interrupts needed */
+        if (running) {
+            BCM_TimerStop();
+            running = false;
+        }
+        swap = false;
+        led_write_mask(plane_mask(0));
+        return;
+    }
+
+    /* While running the interrupt only touches shown once swap is set */
+    swap = false;
+    uint8_t back = running ? (uint8_t)(shown ^ 1U) : shown;
+    for (uint8_t k = 0; k < BCM_PLANES; k++) planes[back][k] = plane_mask(k);
+    if (running) {
+        swap = true;
+        return;
+    }
+    plane = 0;
+    led_write_mask(planes[shown][0]);
+    running = true;
+    BCM_TimerStart(BCM_BASE_US, BCM_BASE_US << 1);
+}
+
+void BCM_SetLevel(uint8_t led, uint8_t level) {
+    uint8_t lv[BCM_LEDS];
+
+    if (led >= BCM_LEDS) return;
+    for (uint8_t i = 0; i < BCM_LEDS; i++) lv[i] = levels[i];
+    lv[led] = level;
+    BCM_SetLevels(lv);
+}
+
+uint8_t BCM_GetLevel(uint8_t led) {
+    return (led < BCM_LEDS) ? levels[led] : 0;
+}
+
+void BCM_SetScale(uint8_t s) {
+    uint8_t lv[BCM_LEDS];
+
+    scale = s;
+    for (uint8_t i = 0; i < BCM_LEDS; i++) lv[i] = levels[i];
+    BCM_SetLevels(lv);
+}
+
+RAMFUNC uint16_t BCM_NextPlane(void) {
+    plane = (uint8_t)((plane + 1U) % BCM_PLANES);
+    if (plane == 0 && swap) {
+        shown ^= 1U;
+        swap = false;
+    }
+    led_write_mask(planes[shown][plane]);
+    return (uint16_t)(BCM_BASE_US << ((plane + 1U) % BCM_PLANES));
+}
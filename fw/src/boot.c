@@ -0,0 +1,34 @@
+/* Boot phase timestamps */
+
+#include "boot.h"
+#include "timer.h"
+
+static const char * const names[BOOT_PHASES] = {
+    [BOOT_SYSTEM] = "System_Init",
+    [BOOT_UART] = "UART",
+    [BOOT_LED] = "LED",
+    [BOOT_I2C] = "I2C",
+    [BOOT_SETTINGS] = "settings",
+    [BOOT_CONFIG] = "config",
+    [BOOT_LEDS_ON] = "LEDs on",
+    [BOOT_READY] = "prompt",
+};
+
+static uint32_t at_us[BOOT_PHASES];
+static uint8_t done;            /* Bit per phase */
+
+void boot_mark(boot_phase_t phase) {
+    if (done & (1U << phase)) return;
+    at_us[phase] = micros();
+    done |= (uint8_t)(1U << phase);
+}
+
+bool boot_time(boot_phase_t phase, uint32_t *t_us) {
+    if (phase >= BOOT_PHASES || !(done & (1U << phase))) return false;
+    *t_us = at_us[phase];
+    return true;
+}
+
+const char *boot_phase_name(boot_phase_t phase) {
+    return phase < BOOT_PHASES ? names[phase] : "?";
+}
@@ -0,0 +1,113 @@
+/* Button debouncer and gesture detection */
+
+#include "button.h"
+#include "config.h"
+#include "event.h"
+#include "gpio.h"
+#include "pins.h"
+#include "trace.h"
+
+enum {
+    BTN_IDLE,
+    BTN_DOWN,           /* First press held */
+    BTN_RELEASED,       /* Short press, waiting for a second one */
+    BTN_SECOND,         /* Second press of a double click held */
+    BTN_HOLDING,        /* Held past BUTTON_HOLD_MS */
+};
+
+static volatile uint8_t edges;      /* Counted by the EXTI interrupt */
+
+/* Tick context only */
+static struct {
+    uint8_t seen;       /* edges at the last tick */
+    uint8_t accepted;   /* edges when the last level was accepted */
+    uint8_t quiet_ms;   /* Since the last edge, while settling */
+    bool settling;
+    bool down;          /* Accepted level */
+    uint8_t state;
+    uint8_t repeats;
+    uint32_t first_ms;  /* First edge of the change being settled */
+    uint32_t press_ms;
+    uint32_t t_ms;      /* Release (BTN_RELEASED) or next repeat (BTN_HOLDING) */
+} btn;
+
+void button_init(void) {
+    btn.down = (PIN_READ(BTN) == 0);
+    btn.state = btn.down ? BTN_SECOND : BTN_IDLE;   /* Held at boot: no gesture */
+    GPIO_EnableIRQ(BTN_GPIO_PORT, BTN_GPIO_PIN, GPIO_EDGE_BOTH);
+}
+
+void button_edge(void) {
+    edges++;
+}
+
+/* Gesture paths stay in flash, the every-millisecond tick runs from SRAM */
+static __attribute__((noinline)) void emit(uint8_t gesture, uint8_t count, uint32_t t_ms) {
+    /* Lost when the queue is full: the main loop is stuck anyway */
+    event_post(EVENT_BUTTON, gesture, count, t_ms * 1000U);
+}
+
+/* Accepted level change; t_ms is its first edge */
+static __attribute__((noinline)) void change(bool down, uint32_t t_ms) {
+    btn.down = down;
+    if (down) {
+        if (btn.state == BTN_RELEASED) {
+            emit(BUTTON_DOUBLE, 1, t_ms);
+            btn.state = BTN_SECOND;
+        } else {
+            btn.state = BTN_DOWN;
+            btn.press_ms = t_ms;
+        }
+    } else if (btn.state == BTN_DOWN && t_ms - btn.press_ms >= BUTTON_LONG_MS) {
+        emit(BUTTON_LONG, 1, btn.press_ms);
+        btn.state = BTN_IDLE;
+    } else if (btn.state == BTN_DOWN) {
+        btn.state = BTN_RELEASED;
+        btn.t_ms = t_ms;
+    } else {
+        btn.state = BTN_IDLE;
+    }
+}
+
+RAMFUNC void button_tick(uint32_t now_ms) {
+    uint8_t n = edges;
+
+    if (n != btn.seen) {
+        if (!btn.settling) btn.first_ms = now_ms;
+        btn.seen = n;
+        btn.settling = true;
+        btn.quiet_ms = 0;
+    } else if (btn.settling && ++btn.quiet_ms >= BUTTON_SETTLE_MS) {
+        /* A press and release inside the settle time is bounce or noise */
+        bool down = (PIN_READ(BTN) == 0);
+        btn.settling = false;
+        if (down != btn.down) {
+            trace(TRACE_BUTTON, down, (uint8_t)(n - btn.accepted));
+            btn.accepted = n;
+            change(down, btn.first_ms);
+        }
+    }
+
+    switch (btn.state) {
+        case BTN_DOWN:
+            if (now_ms - btn.press_ms >= BUTTON_HOLD_MS) {
+                btn.state = BTN_HOLDING;
+                btn.repeats = 0;
+                btn.t_ms = now_ms;
+            }
+            break;
+        case BTN_RELEASED:
+            if (now_ms - btn.t_ms >= BUTTON_DOUBLE_MS) {
+                emit(BUTTON_SHORT, 1, btn.press_ms);
+                btn.state = BTN_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+    if (btn.state == BTN_HOLDING && (int32_t)(now_ms - btn.t_ms) >= 0) {
+        if (btn.repeats < 0xFFU) btn.repeats++;
+        emit(BUTTON_HOLD, btn.repeats, now_ms);
+        btn.t_ms = now_ms + BUTTON_REPEAT_MS;
+    }
+}
@@ -7,9 +7,19 @@
 #include "config.h"
 #include "timer.h"
 #include "i2c_eeprom.h"
+#include "storage.h"
 #include "pins.h"
-#include "stm32c0xx.h"
-#include "core_cm0plus.h"
+#include "system.h"
+#include "pattern.h"
+#include "morse.h"
+#include "cwkey.h"
+#include "power.h"
+#include "log.h"
+#include "trace.h"
+#include "fault.h"
+#include "watchdog.h"
+#include "mem.h"
+#include "boot.h"
 #include <string.h>
 #include <strings.h>
 #include <ctype.h>
@@ -22,6 +32,7 @@ extern uint32_t led_blink_times[5];
 
 #define FIRMWARE_VERSION "1.5.2-base"
 #define SYSTEM_HOSTNAME "SRAL-SAO2"
+#define CLI_BAUD_MIN 9600U     /* Slowest console for the watchdog CLI deadline */
 
 /* EEPROM layout constants */
 #define SAO_MAGIC_LIFE 0x4546494C  /* 'L' 'I' 'F' 'E' little-endian */
@@ -30,9 +41,23 @@ extern uint32_t led_blink_times[5];
 #define FIRMWARE_AREA_START 0x40
 #define CALLSIGN_OFFSET (FIRMWARE_AREA_START)
 #define CALLSIGN_SLOT_LEN 14  /* 13 chars + NUL */
-/* CW message storage next to callsign: allow up to 20 visible chars + NUL */
+/* CW message 0 next to callsign (packed, owned by pattern.c) */
 #define CW_SLOT_OFFSET (CALLSIGN_OFFSET + CALLSIGN_SLOT_LEN)
-#define CW_SLOT_LEN 21 /* 20 chars + NUL */
+/* CW settings after the user pattern slots: WPM, Farnsworth WPM (0 = default),
+   selected message */
+#define CW_SPEED_OFFSET 0xED
+#define CW_SPEED_LEN 3
+/* Auto-blink mode at boot + 1 (0 = default), saved by holding the button */
+#define BOOT_MODE_OFFSET 0xF0
+/* Boot flags; any value but these (0xFF in a blank EEPROM) means none */
+#define BOOT_FLAGS_OFFSET 0xF1
+#define BOOT_FLAG_FAST 0x01
+/* CW settings, boot mode and flags: read in one go before anything else */
+#define SETTINGS_OFFSET CW_SPEED_OFFSET
+#define SETTINGS_LEN (BOOT_FLAGS_OFFSET + 1 - SETTINGS_OFFSET)
+#define CW_WPM_MIN 5
+#define CW_WPM_MAX 40
+#define CW_WPM_DEFAULT 12
 
 /* Default SAO binary descriptor (54 bytes) to write when EEPROM is corrupted.
     Format per Badge.Team binary_descriptor spec used by SRAL-SAO2.
@@ -62,57 +87,82 @@ static const uint8_t default_sao[54] = {
 /* Default callsign to use when initializing EEPROM */
 #define DEFAULT_CALLSIGN "wheel"
 
+static void uint32_to_str(uint32_t num, char *str, uint8_t max_len);
+
 /* Persistent storage for configuration */
 static char current_callsign[CALLSIGN_SLOT_LEN] = "wheel";  /* Default callsign/nick */
-/* Persistent CW message to be sent via Morse (max 20 chars + NUL)
-    Stored in RAM and persisted to EEPROM. Default is "SRAL". */
-char current_cw[CW_SLOT_LEN] = "SRAL";
+static uint8_t cw_wpm = CW_WPM_DEFAULT;
+static uint8_t cw_farnsworth = 0;  /* 0 = off */
+static uint8_t settings[SETTINGS_LEN];  /* As read at boot */
+static uint8_t boot_flags = 0;
+
+/* Default contents of one EEPROM byte: SAO header (0x00..0x35), [[MARKER]]
+   (0x36..0x3F), callsign and CW slots, zero for the rest of the firmware area. */
+static uint8_t EEPROM_DefaultByte(uint16_t addr) {
+    static const char otp[] = "[[MARKER]]";
+    static const uint8_t def_cw[] = { 0x84, 0xCF, 0x28, 0x6C };   /* "SRAL", packed */
+
+    if (addr < sizeof(default_sao)) return default_sao[addr];
+    if (addr < MARKER_OFF + MARKER_LEN) return (uint8_t)otp[addr - MARKER_OFF];
+    if (addr >= CALLSIGN_OFFSET && addr < CALLSIGN_OFFSET + sizeof(DEFAULT_CALLSIGN)) {
+        return (uint8_t)DEFAULT_CALLSIGN[addr - CALLSIGN_OFFSET];
+    }
+    if (addr >= CW_SLOT_OFFSET && addr < CW_SLOT_OFFSET + sizeof(def_cw)) {
+        return def_cw[addr - CW_SLOT_OFFSET];
+    }
+    return 0x00;
+}
 
 /* Helper: initialize the EEPROM to the firmware defaults.
     This rewrites the SAO header (0x00..0x35), [[MARKER]] (0x36..0x3F),
    zeroes the firmware area (0x40..0xFF) and writes the default callsign into
-   the reserved callsign slot. */
+   the reserved callsign slot. Pages that already hold the default image are
+   skipped, so resetting an already-default badge costs no write cycles.
+   The SAO descriptor always goes to the 24C02 (if fitted), everything from
+   [[MARKER]] on goes to the selected storage backend. A failed write stops
+   the reset with an error; the defaults still apply in RAM. */
 static void EEPROM_InitializeDefaults(void) {
-    UART_SendString("EEPROM reset to defaults\r\n");
-
-    /* Write default SAO header */
-    for (int i = 0; i < (int)sizeof(default_sao); i++) {
-        eeprom_write_byte(i, default_sao[i]);
-        delay_us(5000);
-    }
-
-    /* Write [[MARKER]] marker */
-    const char otp[] = "[[MARKER]]";
-    for (int i = 0; i < MARKER_LEN; i++) {
-        eeprom_write_byte(MARKER_OFF + i, (uint8_t)otp[i]);
-        delay_us(5000);
-    }
+    uint32_t total = 0;
+    bool ok = true;
 
-    /* Zero firmware internal data area (0x40..0xFF) */
-    for (uint16_t a = FIRMWARE_AREA_START; a <= 0xFF; a++) {
-        eeprom_write_byte(a, 0x00);
-        delay_us(5000);
+    for (uint16_t page = 0; ok && page < EEPROM_SIZE; page += EEPROM_PAGE_SIZE) {
+        uint8_t buf[EEPROM_PAGE_SIZE];
+        uint16_t written = 0;
+        uint16_t n_sao = 0;
+        for (uint16_t i = 0; i < EEPROM_PAGE_SIZE; i++) {
+            buf[i] = EEPROM_DefaultByte(page + i);
+        }
+        if (page < MARKER_OFF) {
+            n_sao = MARKER_OFF - page;
+            if (n_sao > EEPROM_PAGE_SIZE) n_sao = EEPROM_PAGE_SIZE;
+            if (storage_eeprom_present()) {
+                ok = (eeprom_update_block(page, buf, n_sao, &written) == 0);
+                total += written;
+            }
+        }
+        if (ok && n_sao < EEPROM_PAGE_SIZE) {
+            ok = (storage_update(page + n_sao, buf + n_sao, EEPROM_PAGE_SIZE - n_sao, &written) == 0);
+            total += written;
+        }
     }
 
-    /* Write default callsign into reserved slot */
     strncpy(current_callsign, DEFAULT_CALLSIGN, CALLSIGN_SLOT_LEN);
     current_callsign[CALLSIGN_SLOT_LEN - 1] = '\0';
-    for (size_t i = 0; i < CALLSIGN_SLOT_LEN; i++) {
-        uint8_t b = (i < strlen(current_callsign)) ? (uint8_t)current_callsign[i] : 0;
-        eeprom_write_byte(CALLSIGN_OFFSET + i, b);
-        delay_us(5000);
-        if (b == 0) break;
-    }
+    cw_wpm = CW_WPM_DEFAULT;
+    cw_farnsworth = 0;
+    memset(settings, 0, sizeof(settings));
+    boot_flags = 0;
 
-    /* Initialize CW slot to default "SRAL" and write to EEPROM */
-    strncpy(current_cw, "SRAL", CW_SLOT_LEN);
-    current_cw[CW_SLOT_LEN - 1] = '\0';
-    for (size_t i = 0; i < CW_SLOT_LEN; i++) {
-        uint8_t b = (i < strlen(current_cw)) ? (uint8_t)current_cw[i] : 0;
-        eeprom_write_byte(CW_SLOT_OFFSET + (uint16_t)i, b);
-        delay_us(5000);
-        if (b == 0) break;
+    if (!ok) {
+        UART_SendString("Err: Failed to reset EEPROM\r\n");
+        return;
     }
+
+    char str[8];
+    uint32_to_str(total, str, sizeof(str));
+    UART_SendString("EEPROM reset to defaults (");
+    UART_SendString(str);
+    UART_SendString(" B written)\r\n");
 }
 
 static char cli_buffer[CLI_BUFFER_SIZE];
@@ -127,16 +177,39 @@ static bool awaiting_reset_confirmation = false;
 /* Suppress prompt after command */
 static bool suppress_prompt_after_command = false;
 
+/* 'pat load' in progress: input lines are pattern data */
+static bool pat_loading = false;
+static bool pat_load_b64 = false;
+/* 'cw load' in progress: input lines are message text */
+static bool cw_loading = false;
+static bool cw_load_more = false;   /* Text before this line, join with a space */
+
 /* Forward declarations */
 static void CLI_ParseCommand(const char *cmd);
 static void CLI_Help(void);
 static void CLI_StartLedBlink(int led_num);
 
 /* Flash storage functions */
-static void CLI_LoadConfig(void);
 static void CLI_SaveConfig(void);
 static bool CLI_ValidateCallsign(const char *callsign);
 
+/* User pattern upload */
+static void CLI_PatternCommand(const char *args);
+static void CLI_CWSpeedCommand(const char *args);
+static void CLI_KeyCommand(const char *args);
+static void CLI_ClockCommand(const char *args);
+static void CLI_LogCommand(const char *args);
+static void CLI_TraceCommand(const char *args);
+static void CLI_BootCommand(const char *args);
+static void CLI_FaultReport(void);
+static void CLI_WatchdogLine(void);
+#ifndef BOARD_SIM
+static void CLI_MemCommand(void);
+#endif
+static void CLI_CWCommand(const char *args);
+static void CLI_PatternLine(const char *line);
+static void CLI_CWLine(const char *line);
+
 /* Helper function to convert uint32_t to string */
 static void uint32_to_str(uint32_t num, char *str, uint8_t max_len) {
     if (num == 0) {
@@ -219,10 +292,33 @@ static void CLI_DisplayUptime(void) {
     UART_SendString(" ms\r\n");
 }
 
+/* Auto-blink mode saved with a button hold; a user pattern only counts
+   once pattern_init() has checked its slot */
+static void CLI_ApplyBootMode(void) {
+    extern volatile uint8_t led_auto_mode;
+    uint8_t b = settings[BOOT_MODE_OFFSET - SETTINGS_OFFSET];
+
+    if (b && pattern_name(b - 1U)) led_auto_mode = b - 1U;
+}
+
 void CLI_Init(void) {
     cli_index = 0;
     memset(cli_buffer, 0, sizeof(cli_buffer));
-    CLI_LoadConfig();  // Load saved configuration
+
+    storage_init();
+    if (storage_read(SETTINGS_OFFSET, settings, SETTINGS_LEN) != 0) {
+        memset(settings, 0, sizeof(settings));
+    }
+    /* Out of range values (0 in a fresh image) mean the default */
+    cw_wpm = (settings[0] >= CW_WPM_MIN && settings[0] <= CW_WPM_MAX) ? settings[0] : CW_WPM_DEFAULT;
+    cw_farnsworth = (settings[1] >= CW_WPM_MIN && settings[1] < cw_wpm) ? settings[1] : 0;
+    pattern_cw_speed(cw_wpm, cw_farnsworth);
+    if (settings[BOOT_FLAGS_OFFSET - SETTINGS_OFFSET] == BOOT_FLAG_FAST) boot_flags = BOOT_FLAG_FAST;
+    CLI_ApplyBootMode();
+}
+
+bool CLI_FastBoot(void) {
+    return (boot_flags & BOOT_FLAG_FAST) != 0;
 }
 
 void CLI_PrintPrompt(void) {
@@ -247,13 +343,21 @@ void CLI_ProcessChar(char c) {
                     *end = '\0';
                     end--;
                 }
+                uint32_t t0 = micros();
+                trace(TRACE_CMD, (uint8_t)strlen(cli_buffer),
+                      (uint16_t)((uint8_t)cli_buffer[0] | (uint8_t)cli_buffer[1] << 8));
                 CLI_ParseCommand(cli_buffer);
+                trace(TRACE_CMD_DONE, 0, trace_since(t0));
             }
         }
 
         cli_index = 0;
         /* Only show prompt if not suppressing */
-        if (!suppress_prompt_after_command) {
+        if (pat_loading) {
+            UART_SendString("pat> ");
+        } else if (cw_loading) {
+            UART_SendString("cw> ");
+        } else if (!suppress_prompt_after_command) {
             CLI_PrintPrompt();
         }
         suppress_prompt_after_command = false;
@@ -274,105 +378,100 @@ void CLI_ProcessChar(char c) {
     }
 }
 
-static void CLI_LoadConfig(void) {
+void CLI_LoadConfig(void) {
+    /* [[MARKER]] and the callsign slot after it in one read */
+    uint8_t buf[MARKER_LEN + CALLSIGN_SLOT_LEN];
 
-    // For SRAL-SAO2, read from I2C EEPROM
-    // Check for SAO magic 'LIFE' at address 0x00-0x03
-    uint32_t magic = 0;
-    for (int i = 0; i < 4; i++) {
-        uint8_t byte;
-        if (eeprom_read_byte(i, &byte) != 0) {
-            return;  // EEPROM read error, keep defaults
-        }
-        magic |= ((uint32_t)byte << (i * 8));
-    }
-
-    // Check for [[MARKER]] marker at 0x36
-    char otp_buf[MARKER_LEN + 1];
-    for (int i = 0; i < MARKER_LEN; i++) {
-        uint8_t b;
-        if (eeprom_read_byte(MARKER_OFF + i, &b) != 0) {
-            otp_buf[i] = '\0';
-            break;
+    // Check for SAO magic 'LIFE' at address 0x00-0x03 (external EEPROM only)
+    // A read error keeps the defaults in RAM, without rewriting the EEPROM;
+    // the CW messages and the boot mode below still apply
+    bool life_read = true, life_ok = true;
+    if (storage_eeprom_present()) {
+        if (eeprom_read_block(0, buf, 4) != 0) {
+            life_read = false;
+        } else {
+            uint32_t magic = (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+                             ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+            life_ok = (magic == SAO_MAGIC_LIFE);
         }
-        otp_buf[i] = (char)b;
     }
-    otp_buf[MARKER_LEN] = '\0';
 
-    bool life_ok = (magic == SAO_MAGIC_LIFE);
-    bool otp_ok = (strncmp(otp_buf, "[[MARKER]]", MARKER_LEN) == 0);
+    // Check for [[MARKER]] marker at 0x36 in config storage
+    bool read_ok = life_read && (storage_read(MARKER_OFF, buf, sizeof(buf)) == 0);
+    bool otp_ok = read_ok && (strncmp((const char *)buf, "[[MARKER]]", MARKER_LEN) == 0);
 
-    if (!life_ok || !otp_ok) {
+    if (life_read && (!life_ok || !otp_ok)) {
         EEPROM_InitializeDefaults();
+        pattern_cw_speed(cw_wpm, cw_farnsworth);
     }
+    pattern_init();
 
-    // Read callsign from firmware area (fixed slot at CALLSIGN_OFFSET)
-    for (size_t i = 0; i < CALLSIGN_SLOT_LEN; i++) {
-        uint8_t byte;
-        if (eeprom_read_byte(CALLSIGN_OFFSET + (uint16_t)i, &byte) != 0) {
-            return; // EEPROM read error
-        }
-        current_callsign[i] = (char)byte;
-        if (byte == 0) break;
+    // Callsign from firmware area (fixed slot at CALLSIGN_OFFSET), unless
+    // the defaults were just written
+    if (otp_ok) {
+        memcpy(current_callsign, buf + MARKER_LEN, CALLSIGN_SLOT_LEN);
+        current_callsign[CALLSIGN_SLOT_LEN - 1] = '\0';
     }
-    current_callsign[CALLSIGN_SLOT_LEN - 1] = '\0';
 
-    /* Read CW message from EEPROM */
-    for (size_t i = 0; i < CW_SLOT_LEN; i++) {
-        uint8_t byte;
-        if (eeprom_read_byte(CW_SLOT_OFFSET + (uint16_t)i, &byte) != 0) {
-            return; // EEPROM read error
-        }
-        current_cw[i] = (char)byte;
-        if (byte == 0) break;
-    }
-    current_cw[CW_SLOT_LEN - 1] = '\0';
+    /* The selected CW message and a user pattern as the boot mode need
+       the slots read by pattern_init() */
+    uint8_t sel = settings[CW_SPEED_OFFSET + 2 - SETTINGS_OFFSET];
+    pattern_cw_select((sel < PATTERN_CW_MSGS) ? sel : 0);
+    CLI_ApplyBootMode();
+}
 
+void CLI_SaveMode(void) {
+    extern volatile uint8_t led_auto_mode;
+    uint8_t b = (uint8_t)(led_auto_mode + 1U);
+
+    if (storage_update(BOOT_MODE_OFFSET, &b, 1, NULL) != 0) {
+        UART_SendString("Err: Failed to save mode\r\n");
+        return;
+    }
+    UART_SendString("Boot mode saved: ");
+    UART_SendString(pattern_name(led_auto_mode));
+    UART_SendString("\r\n");
 }
 
 static void CLI_SaveConfig(void) {
 //    UART_SendString("Saving cfg to EEPROM...\r\n");
 
     // Check [[MARKER]] marker integrity
-    char otp_buf[MARKER_LEN + 1];
-    bool otp_valid = true;
-    for (int i = 0; i < MARKER_LEN; i++) {
-        uint8_t b;
-        if (eeprom_read_byte(MARKER_OFF + i, &b) != 0) {
-            otp_valid = false;
-            break;
-        }
-        otp_buf[i] = (char)b;
-    }
-    otp_buf[MARKER_LEN] = '\0';
-    
-    if (!otp_valid || strncmp(otp_buf, "[[MARKER]]", MARKER_LEN) != 0) {
+    char otp_buf[MARKER_LEN];
+    if (storage_read(MARKER_OFF, (uint8_t *)otp_buf, MARKER_LEN) != 0 ||
+        strncmp(otp_buf, "[[MARKER]]", MARKER_LEN) != 0) {
         UART_SendString("EEPROM corrupted, say 'reset'\r\n");
         return;
     }
 
-    // Write callsign to firmware area slot (14 bytes)
-    for (size_t i = 0; i < CALLSIGN_SLOT_LEN; i++) {
-        uint8_t b = (i < strlen(current_callsign)) ? (uint8_t)current_callsign[i] : 0;
-        if (eeprom_write_byte(CALLSIGN_OFFSET + (uint16_t)i, b) != 0) {
-            UART_SendString("Err: Failed to save callsign\r\n");
-            return;
-        }
-        delay_us(5000);
-        if (b == 0) break;
+    // Write the callsign slot (14 bytes, NUL-padded) and the CW settings; the
+    // CW messages are stored by pattern.c as they are set.
+    // Only bytes that differ from the EEPROM contents are written.
+    uint8_t slot[CALLSIGN_SLOT_LEN];
+    uint16_t written = 0, total = 0;
+
+    strncpy((char *)slot, current_callsign, CALLSIGN_SLOT_LEN);
+    slot[CALLSIGN_SLOT_LEN - 1] = 0;
+    if (storage_update(CALLSIGN_OFFSET, slot, CALLSIGN_SLOT_LEN, &written) != 0) {
+        UART_SendString("Err: Failed to save callsign\r\n");
+        return;
     }
+    total += written;
 
-    // Write CW message to firmware area slot (21 bytes)
-    for (size_t i = 0; i < CW_SLOT_LEN; i++) {
-        uint8_t b = (i < strlen(current_cw)) ? (uint8_t)current_cw[i] : 0;
-        if (eeprom_write_byte(CW_SLOT_OFFSET + (uint16_t)i, b) != 0) {
-            UART_SendString("Err: Failed to save CW msg\r\n");
-            return;
-        }
-        delay_us(5000);
-        if (b == 0) break;
+    slot[0] = (cw_wpm == CW_WPM_DEFAULT) ? 0 : cw_wpm;
+    slot[1] = cw_farnsworth;
+    slot[2] = pattern_cw_selected();
+    if (storage_update(CW_SPEED_OFFSET, slot, CW_SPEED_LEN, &written) != 0) {
+        UART_SendString("Err: Failed to save CW speed\r\n");
+        return;
     }
-    UART_SendString("Saved\r\n");
+    total += written;
+
+    char str[8];
+    uint32_to_str(total, str, sizeof(str));
+    UART_SendString("Saved (");
+    UART_SendString(str);
+    UART_SendString(" B written)\r\n");
 }
 
 static bool CLI_ValidateCallsign(const char *callsign) {
@@ -389,18 +488,40 @@ static bool CLI_ValidateCallsign(const char *callsign) {
     return true;
 }
 
-/* Validate a CW message: printable ASCII characters, length 1..20 */
+/* Validate a CW message for the selected slot: 1..capacity characters,
+   each with a Morse code, prosigns closed */
 static bool CLI_ValidateCW(const char *msg) {
     size_t len = strlen(msg);
-    if (len == 0 || len > (size_t)(CW_SLOT_LEN - 1)) return false;
-    for (size_t i = 0; i < len; ++i) {
-        char c = msg[i];
-        if (c == ' ') continue; /* space allowed as word separator */
-        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) continue;
-        if (c >= '0' && c <= '9') continue;
-        return false; /* other characters not allowed */
+    bool prosign = false;
+
+    if (len == 0 || len > pattern_cw_capacity(pattern_cw_selected())) return false;
+    while (*msg) {
+        if (!morse_accept(*msg++, &prosign)) return false;
     }
-    return true;
+    return !prosign;
+}
+
+/* Print a stored message, unpacked 8 characters at a time */
+static void CLI_SendCW(uint8_t msg) {
+    char buf[9];
+    uint8_t n;
+
+    for (uint8_t at = 0; (n = pattern_cw_read(msg, at, buf)) != 0; at += n) {
+        buf[n] = '\0';
+        UART_SendString(buf);
+    }
+}
+
+/* Replace the selected message with a validated text */
+static void CLI_SetCW(const char *msg) {
+    if (pattern_cw_begin(pattern_cw_selected()) != 0 || pattern_cw_text(msg) != 0 ||
+        pattern_cw_end() != 0) {
+        UART_SendString("Err: Failed to save CW msg\r\n");
+        return;
+    }
+    UART_SendString("CW msg set: ");
+    CLI_SendCW(pattern_cw_selected());
+    UART_SendString("\r\n");
 }
 
 static void CLI_ParseCommand(const char *cmd) {
@@ -408,12 +529,23 @@ static void CLI_ParseCommand(const char *cmd) {
         if (strcmp(cmd, "y") == 0 || strcmp(cmd, "Y") == 0) {
             // Reset in persistent storage by reinitializing EEPROM to defaults
             EEPROM_InitializeDefaults();
+            pattern_init();
+            pattern_cw_speed(cw_wpm, cw_farnsworth);
+            pattern_cw_select(0);
         } else {
             UART_SendString("Cancelled\r\n");
         }
         awaiting_reset_confirmation = false;
         return;
     }
+    if (pat_loading) {
+        CLI_PatternLine(cmd);
+        return;
+    }
+    if (cw_loading) {
+        CLI_CWLine(cmd);
+        return;
+    }
 
     if (strcmp(cmd, "help") == 0) {
         CLI_Help();
@@ -437,14 +569,17 @@ static void CLI_ParseCommand(const char *cmd) {
         awaiting_reset_confirmation = true;
         suppress_prompt_after_command = true;
     }
+    else if (strcmp(cmd, "reboot dfu") == 0) {
+        UART_SendString("Bootloader: send the image with tools/fwupdate.py\r\n");
+        UART_Flush();
+        System_EnterBootloader();
+    }
     else if (strcmp(cmd, "reboot") == 0 || strcmp(cmd, "restart") == 0) {
         UART_SendString("Rebooting..\r\n");
         // Small delay to let UART finish transmitting
         for (volatile int i = 0; i < 100000; i++);
-        // Trigger system reset using CMSIS function
-        NVIC_SystemReset();
-        // Should not reach here
-        while (1);
+        // Trigger system reset
+        System_Reset();
     }
     else if (strncmp(cmd, "setcall ", 8) == 0 || strncmp(cmd, "setnick ", 8) == 0) {
         const char *callsign = cmd + 8;
@@ -468,6 +603,7 @@ static void CLI_ParseCommand(const char *cmd) {
     }
     else if (strcmp(cmd, "dmesg") == 0) {
         CLI_ShowBootMessages(false);
+        CLI_FaultReport();
     }
     else if (strcmp(cmd, "led on") == 0) {
         extern bool debug_led_blinking;
@@ -492,8 +628,8 @@ static void CLI_ParseCommand(const char *cmd) {
     else if (strcmp(cmd, "blinkmode") == 0 || strcmp(cmd, "automode") == 0 || strcmp(cmd, "bm") == 0) {
     extern volatile uint8_t led_auto_mode;
         UART_SendString("Auto-blink mode: ");
-        if (led_auto_mode < 9) {
-            UART_SendString(led_blink_mode_names[led_auto_mode]);
+        if (pattern_name(led_auto_mode)) {
+            UART_SendString(pattern_name(led_auto_mode));
             char buf[16];
             UART_SendString(" (");
             uint32_to_str(led_auto_mode, buf, sizeof(buf));
@@ -507,7 +643,11 @@ static void CLI_ParseCommand(const char *cmd) {
             UART_SendString(")");
         }
         UART_SendString("\r\n");
-        UART_SendString("Use button or 'bm <0-6>' to change\r\n");
+        char max[4];
+        uint32_to_str(pattern_count() - 1, max, sizeof(max));
+        UART_SendString("Use button or 'bm <0-");
+        UART_SendString(max);
+        UART_SendString(">' to change\r\n");
     }
     else if (strncmp(cmd, "blinkmode ", 10) == 0 || strncmp(cmd, "automode ", 9) == 0 || strncmp(cmd, "bm ", 3) == 0) {
         extern volatile uint8_t led_auto_mode;
@@ -520,17 +660,14 @@ static void CLI_ParseCommand(const char *cmd) {
             param = cmd + 9;
         }
         int mode = atoi(param);
-        int max_mode = 6;
+        int max_mode = pattern_count() - 1;
         
-        if (mode >= 0 && mode <= max_mode) {
+        if (mode >= 0 && mode <= max_mode && pattern_name(mode)) {
             led_auto_mode = mode;
             UART_SendString("Auto-blink mode set to: ");
-            UART_SendString(led_blink_mode_names[led_auto_mode]);
+            UART_SendString(pattern_name(led_auto_mode));
             UART_SendString("\r\n");
-            /* Clear all LEDs when changing modes */
-            for (int i = 1; i <= 5; i++) {
-                PWM_SetDutyCycle(i, 0);
-            }
+            /* The pattern engine clears the LEDs when it picks up the new mode */
             /* Turn off all LEDs when entering OFF mode */
             if (led_auto_mode == 0) {
                 extern bool led_blinking[5];
@@ -538,11 +675,18 @@ static void CLI_ParseCommand(const char *cmd) {
                     led_blinking[i] = false;
                 }
             }
+        } else if (mode >= 0 && pattern_is_user(mode)) {
+            UART_SendString("Pattern slot empty, use 'pat load <n>'\r\n");
         } else {
-            UART_SendString("Invalid mode. Use 0-6 (");
-            for (int i = 0; i <= 6; i++) {
+            char buf[8];
+            uint32_to_str(max_mode, buf, sizeof(buf));
+            UART_SendString("Invalid mode. Use 0-");
+            UART_SendString(buf);
+            UART_SendString(" (");
+            for (int i = 0; i <= max_mode; i++) {
+            if (!pattern_name(i)) continue;
             if (i > 0) UART_SendString("/");
-            UART_SendString(led_blink_mode_names[i]);
+            UART_SendString(pattern_name(i));
             }
             UART_SendString(")\r\n");}
     }
@@ -552,8 +696,8 @@ static void CLI_ParseCommand(const char *cmd) {
             // Stop all LED blinking
             for (int i = 0; i < 5; i++) {
                 led_blinking[i] = false;
-                PWM_SetDutyCycle(i + 1, 0);
             }
+            led_write_bits(0, LED_MASK_ALL);
             UART_SendString("All LEDs off\r\n");
         } else {
             // Parse LED number
@@ -575,12 +719,26 @@ static void CLI_ParseCommand(const char *cmd) {
         }
     }
     else if (strcmp(cmd, "status") == 0) {
+        char str[8];
         UART_SendString("System Status:\r\n");
         UART_SendString("  Board: SRAL-SAO2 (6 KB RAM / 32 KB flash, 256 B EEPROM)\r\n");
-        UART_SendString("  Clock: 12 MHz\r\n");
+        CLI_ClockCommand("");
+        UART_SendString("  Power: ");
+        UART_SendString(power_source_name(power_source()));
+        UART_SendString(" profile, switched to badge ");
+        uint32_to_str(power_switches(POWER_BADGE), str, sizeof(str));
+        UART_SendString(str);
+        UART_SendString("x, to battery ");
+        uint32_to_str(power_switches(POWER_BATTERY), str, sizeof(str));
+        UART_SendString(str);
+        UART_SendString("x\r\n");
         UART_SendString("  FW: v");
         UART_SendString(FIRMWARE_VERSION);
-        UART_SendString("\r\n  ttyS0: 115200 8N1\r\n");
+        UART_SendString("\r\n");
+        UART_SendString("  Storage: ");
+        UART_SendString(storage_backend_name());
+        UART_SendString("\r\n  ");
+        CLI_WatchdogLine();
         UART_SendString("\r\n");
         
         // Add uptime information
@@ -591,6 +749,16 @@ static void CLI_ParseCommand(const char *cmd) {
         UART_SendString("Uptime: ");
         CLI_DisplayUptime();
     }
+#ifndef BOARD_SIM
+    else if (strcmp(cmd, "mem") == 0) {
+        CLI_MemCommand();
+    }
+#endif
+#if ENABLE_GPIO_BENCH && !defined(BOARD_SIM)
+    else if (strcmp(cmd, "bench") == 0) {
+        GPIO_Bench();
+    }
+#endif
     else if (strcmp(cmd, "exit") == 0 || strcmp(cmd, "logout") == 0) {
         UART_SendString("Haven't seen Inception? Be careful out there\r\n");
     }
@@ -628,28 +796,29 @@ static void CLI_ParseCommand(const char *cmd) {
     else if (strcmp(cmd, "cat") == 0) {
         UART_SendString("Usage: cat <filename>\r\n");   
     }
-    else if (strncmp(cmd, "cw ", 3) == 0) {
-        /* Set CW message (max 13 printable chars) */
-        const char *msg = cmd + 3;
-        while (*msg == ' ') msg++; /* skip extra spaces */
-        if (!CLI_ValidateCW(msg)) {
-            UART_SendString("Invalid CW message. Use 1-20 chars: A-Z, 0-9 and space only.\r\n");
-        } else {
-            strncpy(current_cw, msg, CW_SLOT_LEN);
-            /* ensure NUL termination */
-            current_cw[CW_SLOT_LEN - 1] = '\0';
-              /* Persist to EEPROM */
-              CLI_SaveConfig();
-            UART_SendString("CW msg set: ");
-            UART_SendString(current_cw);
-            UART_SendString("\r\n");
-        }
+    else if (strcmp(cmd, "cw") == 0 || strncmp(cmd, "cw ", 3) == 0) {
+        CLI_CWCommand(cmd + 2);
     }
-    else if (strcmp(cmd, "cw") == 0) {
-        UART_SendString("Current CW msg: ");
-        if (current_cw[0]) UART_SendString(current_cw);
-        else UART_SendString("(none)");
-        UART_SendString("\r\n");
+    else if (strcmp(cmd, "cwspeed") == 0 || strncmp(cmd, "cwspeed ", 8) == 0) {
+        CLI_CWSpeedCommand(cmd + 7);
+    }
+    else if (strcmp(cmd, "clock") == 0 || strncmp(cmd, "clock ", 6) == 0) {
+        CLI_ClockCommand(cmd[5] ? cmd + 6 : "");
+    }
+    else if (strcmp(cmd, "log") == 0 || strncmp(cmd, "log ", 4) == 0) {
+        CLI_LogCommand(cmd + 3);
+    }
+    else if (strcmp(cmd, "trace") == 0 || strncmp(cmd, "trace ", 6) == 0) {
+        CLI_TraceCommand(cmd + 5);
+    }
+    else if (strcmp(cmd, "boot") == 0 || strncmp(cmd, "boot ", 5) == 0) {
+        CLI_BootCommand(cmd + 4);
+    }
+    else if (strcmp(cmd, "key") == 0 || strncmp(cmd, "key ", 4) == 0) {
+        CLI_KeyCommand(cmd + 3);
+    }
+    else if (strcmp(cmd, "pat") == 0 || strncmp(cmd, "pat ", 4) == 0) {
+        CLI_PatternCommand(cmd + 3);
     }
     else if (strncmp(cmd, "eeread ", 7) == 0) {
         uint8_t data;
@@ -684,50 +853,686 @@ static void CLI_ParseCommand(const char *cmd) {
     }
 }
 
+static void CLI_SendHex16(uint16_t v) {
+    static const char digits[] = "0123456789ABCDEF";
+    char buf[5];
+    for (uint8_t i = 0; i < 4; i++) buf[i] = digits[(v >> (12 - 4 * i)) & 0xFU];
+    buf[4] = '\0';
+    UART_SendString(buf);
+}
+
+static void CLI_SendHex32(uint32_t v) {
+    CLI_SendHex16((uint16_t)(v >> 16));
+    CLI_SendHex16((uint16_t)v);
+}
+
+/* Boot counter, reset cause and the registers of the last HardFault */
+static void CLI_FaultReport(void) {
+    static const char * const regs[] = { "  r0 ", " r1 ", " r2 ", " r3 ", " r12 ", "\r\n  lr ", " pc ", " xpsr ", " sp " };
+    const fault_record_t *f = fault_last();
+    char str[12];
+
+    UART_SendString("\r\nBoot ");
+    uint32_to_str(fault_boots(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" since power-on, reset by ");
+    UART_SendString(fault_reset_cause());
+    UART_SendString("\r\n");
+    CLI_WatchdogLine();
+    if (!f) {
+        UART_SendString("No faults since power-on\r\n");
+        return;
+    }
+    uint32_to_str(fault_count(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" fault(s), the last in boot ");
+    uint32_to_str(f->boot, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(":\r\n");
+    const uint32_t v[] = { f->r0, f->r1, f->r2, f->r3, f->r12, f->lr, f->pc, f->xpsr, f->sp };
+    for (uint8_t i = 0; i < sizeof(v) / sizeof(v[0]); i++) {
+        UART_SendString(regs[i]);
+        CLI_SendHex32(v[i]);
+    }
+    UART_SendString("\r\n  stack");
+    for (uint8_t i = 0; i < FAULT_STACK_WORDS; i++) {
+        UART_SendChar(' ');
+        CLI_SendHex32(f->stack[i]);
+    }
+    UART_SendString("\r\n");
+}
+
+/* Watchdog resets since power-on and the task that starved the last time */
+static void CLI_WatchdogLine(void) {
+    char str[12];
+
+    uint32_to_str(watchdog_resets(), str, sizeof(str));
+    UART_SendString("Watchdog resets: ");
+    UART_SendString(str);
+    if (watchdog_resets()) {
+        UART_SendString(", the last in boot ");
+        uint32_to_str(watchdog_last_boot(), str, sizeof(str));
+        UART_SendString(str);
+        UART_SendString(", ");
+        UART_SendString(watchdog_task_name(watchdog_last_task()));
+        UART_SendString(" starved");
+    }
+    UART_SendString("\r\n");
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static int b64_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+/* cwspeed [<wpm> [farnsworth_wpm]] */
+static void CLI_CWSpeedCommand(const char *args) {
+    char str[8];
+
+    if (*args) {
+        char *end;
+        long wpm = strtol(args, &end, 10);
+        long fw = 0;
+        while (*end == ' ') end++;
+        if (*end) fw = strtol(end, &end, 10);
+        while (*end == ' ') end++;
+        if (*end || wpm < CW_WPM_MIN || wpm > CW_WPM_MAX || (fw && (fw < CW_WPM_MIN || fw > wpm))) {
+            UART_SendString("Usage: cwspeed <5-40 wpm> [farnsworth wpm, 5..wpm]\r\n");
+            return;
+        }
+        cw_wpm = (uint8_t)wpm;
+        cw_farnsworth = (fw < wpm) ? (uint8_t)fw : 0;
+        pattern_cw_speed(cw_wpm, cw_farnsworth);
+        CLI_SaveConfig();
+    }
+    UART_SendString("CW speed: ");
+    uint32_to_str(cw_wpm, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" wpm");
+    if (cw_farnsworth) {
+        UART_SendString(", Farnsworth ");
+        uint32_to_str(cw_farnsworth, str, sizeof(str));
+        UART_SendString(str);
+        UART_SendString(" wpm");
+    }
+    UART_SendString("\r\n");
+}
+
+/* clock [eco|perf [baud]]: the baud rate falls back to the default when the
+   new clock cannot produce it; neither is saved. Below CLI_BAUD_MIN a long
+   reply would outlast the watchdog's CLI deadline. */
+static void CLI_ClockCommand(const char *args) {
+    char str[12];
+
+    if (*args) {
+        uint8_t profile;
+        uint32_t baud = UART_BAUDRATE;
+        size_t len = strcspn(args, " ");
+        for (profile = 0; profile < CLOCK_PROFILES; profile++) {
+            const char *name = System_ClockProfileName(profile);
+            if (strlen(name) == len && strncmp(args, name, len) == 0) break;
+        }
+        if (args[len]) {
+            char *end;
+            baud = strtoul(args + len + 1, &end, 10);
+            if (*end || baud < CLI_BAUD_MIN) profile = CLOCK_PROFILES;
+        }
+        if (profile == CLOCK_PROFILES) {
+            UART_SendString("Usage: clock [eco|perf [baud]], baud 9600 or more\r\n");
+            return;
+        }
+        System_SetClockProfile(profile);
+        if (baud != UART_GetBaud() && UART_SetBaud(baud) != 0) {
+            UART_SendString("Baud rate not possible at this clock\r\n");
+        }
+    }
+    UART_SendString("  Clock: ");
+    UART_SendString(System_ClockProfileName(System_GetClockProfile()));
+    UART_SendString(", ");
+    uint32_to_str(System_GetClock() / 1000000U, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" MHz\r\n  ttyS0: ");
+    uint32_to_str(UART_GetBaud(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" 8N1\r\n");
+}
+
+/* log [on|off|clear]: binary log records on the console, for
+   tools/logdecode.py; they queue while off until the ring is full */
+static void CLI_LogCommand(const char *args) {
+    char str[12];
+
+    while (*args == ' ') args++;
+    if (strcmp(args, "on") == 0) {
+        log_enable(true);
+    } else if (strcmp(args, "off") == 0) {
+        log_enable(false);
+    } else if (strcmp(args, "clear") == 0) {
+        log_clear();
+    } else if (*args) {
+        UART_SendString("Usage: log [on|off|clear]\r\n");
+        return;
+    }
+    UART_SendString(log_enabled() ? "Log on, " : "Log off, ");
+    uint32_to_str(log_records(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" records, ");
+    uint32_to_str(log_dropped(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" dropped, ");
+    uint32_to_str(log_pending(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" bytes queued\r\n");
+}
+
+/* trace [dump|clear]: the event trace, oldest first, on the micros() clock
+   of the boot that recorded it */
+static void CLI_TraceCommand(const char *args) {
+    char str[12];
+    trace_entry_t e;
+
+    while (*args == ' ') args++;
+    if (strcmp(args, "clear") == 0) {
+        trace_clear();
+        UART_SendString("Trace cleared\r\n");
+        return;
+    }
+    if (*args && strcmp(args, "dump") != 0) {
+        UART_SendString("Usage: trace [dump|clear]\r\n");
+        return;
+    }
+    for (uint8_t i = 0; trace_get(i, &e); i++) {
+        uint32_t us = e.t_us % 1000000U;
+        uint32_to_str(e.t_us / 1000000U, str, sizeof(str));
+        for (size_t n = strlen(str); n < 5; n++) UART_SendChar(' ');
+        UART_SendString(str);
+        UART_SendChar('.');
+        for (uint32_t div = 100000U; div; div /= 10U) UART_SendChar((char)('0' + us / div % 10U));
+        UART_SendChar(' ');
+        UART_SendString(trace_type_name(e.type));
+        UART_SendChar(' ');
+        if (e.type == TRACE_CMD) {
+            /* Length and the first two characters */
+            UART_SendChar((char)(e.arg & 0xFFU));
+            if (e.arg >> 8) UART_SendChar((char)(e.arg >> 8));
+            UART_SendString(e.a > 2 ? "... (" : " (");
+            uint32_to_str(e.a, str, sizeof(str));
+            UART_SendString(str);
+            UART_SendString(")\r\n");
+            continue;
+        }
+        bool done = (e.type == TRACE_STORE_DONE || e.type == TRACE_CMD_DONE);
+        if (!done) {
+            uint32_to_str(e.a, str, sizeof(str));
+            UART_SendString(str);
+            UART_SendChar(' ');
+        }
+        uint32_to_str(e.arg, str, sizeof(str));
+        UART_SendString(str);
+        if (done) {
+            /* Durations saturate at 0xFFFF */
+            UART_SendString(e.arg == 0xFFFFU ? "+ us" : " us");
+            if (e.a) UART_SendString(", failed");
+        }
+        UART_SendString("\r\n");
+    }
+}
+
+/* boot [fast on|off]: when each boot phase ended; the fast boot flag is
+   saved with the boot settings and applies from the next boot */
+static void CLI_BootCommand(const char *args) {
+    char str[12];
+
+    while (*args == ' ') args++;
+    if (*args) {
+        uint8_t flags;
+        if (strcmp(args, "fast on") == 0) {
+            flags = BOOT_FLAG_FAST;
+        } else if (strcmp(args, "fast off") == 0) {
+            flags = 0;
+        } else {
+            UART_SendString("Usage: boot [fast on|off]\r\n");
+            return;
+        }
+        if (storage_update(BOOT_FLAGS_OFFSET, &flags, 1, NULL) != 0) {
+            UART_SendString("Err: Failed to save boot flags\r\n");
+            return;
+        }
+        boot_flags = flags;
+    }
+
+    UART_SendString("Boot phases (ms since the timer started):\r\n");
+    for (uint8_t i = 0; i < BOOT_PHASES; i++) {
+        uint32_t t;
+        const char *name = boot_phase_name((boot_phase_t)i);
+        UART_SendString("  ");
+        UART_SendString(name);
+        for (size_t n = strlen(name); n < 12; n++) UART_SendChar(' ');
+        if (!boot_time((boot_phase_t)i, &t)) {
+            UART_SendString("-\r\n");
+            continue;
+        }
+        uint32_to_str(t / 1000U, str, sizeof(str));
+        UART_SendString(str);
+        UART_SendChar('.');
+        for (uint32_t div = 100U; div; div /= 10U) UART_SendChar((char)('0' + t % 1000U / div % 10U));
+        UART_SendString("\r\n");
+    }
+    UART_SendString("Fast boot: ");
+    UART_SendString(CLI_FastBoot() ? "on" : "off");
+    UART_SendString("\r\n");
+}
+
+#ifndef BOARD_SIM
+static void CLI_MemLine(const char *name, uint16_t bytes, const char *note) {
+    char str[8];
+    UART_SendString(name);
+    uint32_to_str(bytes, str, sizeof(str));
+    for (size_t n = strlen(str); n < 5; n++) UART_SendChar(' ');
+    UART_SendString(str);
+    UART_SendString(note);
+}
+
+/* mem: static sizes from the linker symbols, heap and stack peak use */
+static void CLI_MemCommand(void) {
+    mem_info_t m;
+    char str[8];
+
+    mem_info(&m);
+    UART_SendString("RAM 6144 bytes:\r\n");
+    CLI_MemLine("  .data  ", m.data, " (RAMFUNC ");
+    uint32_to_str(m.ramfunc, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(")\r\n");
+    CLI_MemLine("  .bss   ", m.bss, "\r\n");
+    CLI_MemLine("  .noinit", m.noinit, " trace, fault record\r\n");
+    CLI_MemLine("  heap   ", m.heap, " of ");
+    uint32_to_str(m.heap_max, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" possible\r\n");
+    CLI_MemLine("  stack  ", m.stack_peak, " peak of ");
+    uint32_to_str(m.stack_size, str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" reserved, guard ");
+    UART_SendString(m.guard_ok ? "intact\r\n" : "HIT\r\n");
+    CLI_MemLine("  free   ", m.free, " never touched\r\n");
+}
+#endif
+
+/* Message number argument of the cw subcommands, -1 when invalid */
+static int CLI_CWNumber(const char *arg) {
+    char *end;
+    long msg = strtol(arg, &end, 10);
+    return (end == arg || *end || msg < 0 || msg >= PATTERN_CW_MSGS) ? -1 : (int)msg;
+}
+
+/* cw [<msg> | list | sel <n> | load <n> | del <n>]: the CW messages */
+static void CLI_CWCommand(const char *args) {
+    char str[8];
+    uint8_t sel = pattern_cw_selected();
+    int msg;
+
+    while (*args == ' ') args++;
+    if (*args == '\0') {
+        UART_SendString("Current CW msg: ");
+        if (pattern_cw_length(sel)) CLI_SendCW(sel);
+        else UART_SendString("(none)");
+        UART_SendString("\r\n");
+    }
+    else if (strcmp(args, "list") == 0) {
+        for (uint8_t i = 0; i < PATTERN_CW_MSGS; i++) {
+            uint32_to_str(i, str, sizeof(str));
+            UART_SendString(str);
+            UART_SendString(i == sel ? "*: " : ": ");
+            if (pattern_cw_length(i)) CLI_SendCW(i);
+            else UART_SendString("(none)");
+            UART_SendString(" (");
+            uint32_to_str(pattern_cw_length(i), str, sizeof(str));
+            UART_SendString(str);
+            UART_SendString("/");
+            uint32_to_str(pattern_cw_capacity(i), str, sizeof(str));
+            UART_SendString(str);
+            UART_SendString(" chars)\r\n");
+        }
+    }
+    else if (strncmp(args, "sel ", 4) == 0) {
+        if ((msg = CLI_CWNumber(args + 4)) < 0) {
+            UART_SendString("Invalid CW msg\r\n");
+            return;
+        }
+        if (pattern_cw_select((uint8_t)msg) != 0) UART_SendString("Note: CW msg is empty\r\n");
+        CLI_SaveConfig();
+    }
+    else if (strncmp(args, "load ", 5) == 0) {
+        if ((msg = CLI_CWNumber(args + 5)) < 0 || pattern_cw_begin((uint8_t)msg) != 0) {
+            UART_SendString("Invalid CW msg\r\n");
+            return;
+        }
+        cw_loading = true;
+        cw_load_more = false;
+        uint32_to_str(pattern_cw_capacity((uint8_t)msg), str, sizeof(str));
+        UART_SendString("Send up to ");
+        UART_SendString(str);
+        UART_SendString(" chars, lines are joined with a space; 'end' stores, '.' aborts\r\n");
+    }
+    else if (strncmp(args, "del ", 4) == 0) {
+        if ((msg = CLI_CWNumber(args + 4)) < 0 || pattern_cw_delete((uint8_t)msg) != 0) {
+            UART_SendString("Invalid CW msg (1-2, not empty)\r\n");
+        } else {
+            UART_SendString("CW msg deleted\r\n");
+        }
+    }
+    else if (!CLI_ValidateCW(args)) {
+        uint32_to_str(pattern_cw_capacity(sel), str, sizeof(str));
+        UART_SendString("Invalid CW message. Use 1-");
+        UART_SendString(str);
+        UART_SendString(" chars: A-Z, 0-9, punctuation, space, <prosign>.\r\n");
+    }
+    else {
+        CLI_SetCW(args);
+    }
+}
+
+/* One line of 'cw load' text */
+static void CLI_CWLine(const char *line) {
+    while (*line == ' ') line++;
+    if (strcmp(line, ".") == 0) {
+        cw_loading = false;
+        UART_SendString("Load aborted, CW msg left empty\r\n");
+        return;
+    }
+    if (strcmp(line, "end") == 0) {
+        cw_loading = false;
+        if (pattern_cw_end() != 0) {
+            UART_SendString("Err: empty or open prosign, CW msg left empty\r\n");
+        } else {
+            UART_SendString("CW msg stored\r\n");
+        }
+        return;
+    }
+    if (*line == '\0') return;
+    if ((cw_load_more && pattern_cw_text(" ") != 0) || pattern_cw_text(line) != 0) {
+        cw_loading = false;
+        UART_SendString("Err: bad character or too long, load aborted\r\n");
+        return;
+    }
+    cw_load_more = true;
+}
+
+/* key [on|off|save|clear]: button as a straight key, decoded text */
+static void CLI_KeyCommand(const char *args) {
+    char str[8];
+
+    while (*args == ' ') args++;
+    if (strcmp(args, "on") == 0) {
+        cwkey_clear();
+        cwkey_start();
+        UART_SendString("Keying on BTN, 'key off' to stop:\r\n");
+        return;
+    }
+    if (strcmp(args, "off") == 0) {
+        cwkey_stop();
+    } else if (strcmp(args, "clear") == 0) {
+        cwkey_clear();
+    } else if (strcmp(args, "save") == 0) {
+        /* Decoded text without the trailing word space becomes the CW message */
+        char msg[CWKEY_TEXT_MAX + 1];
+        size_t len = strlen(cwkey_text());
+        memcpy(msg, cwkey_text(), len + 1);
+        while (len && msg[len - 1] == ' ') msg[--len] = '\0';
+        if (!CLI_ValidateCW(msg)) {
+            UART_SendString("Nothing valid to save\r\n");
+            return;
+        }
+        CLI_SetCW(msg);
+        return;
+    } else if (*args) {
+        UART_SendString("Usage: key [on|off|save|clear]\r\n");
+        return;
+    }
+    UART_SendString(cwkey_active() ? "Keying on, " : "Keying off, ");
+    uint32_to_str(cwkey_wpm(), str, sizeof(str));
+    UART_SendString(str);
+    UART_SendString(" wpm: ");
+    UART_SendString(cwkey_text());
+    UART_SendString("\r\n");
+}
+
+/* pat [list] | pat load <n> [hex|b64] | pat del <n> */
+static void CLI_PatternCommand(const char *args) {
+    char str[8];
+
+    while (*args == ' ') args++;
+    if (*args == '\0' || strcmp(args, "list") == 0) {
+        for (uint8_t mode = 0; mode < pattern_count(); mode++) {
+            uint8_t len;
+            uint16_t crc;
+            if (!pattern_is_user(mode)) continue;
+            uint32_to_str(mode, str, sizeof(str));
+            UART_SendString(str);
+            int msg = pattern_user_cw(mode);
+            if (msg >= 0) {
+                UART_SendString(": CW msg ");
+                uint32_to_str((uint32_t)msg, str, sizeof(str));
+                UART_SendString(str);
+                UART_SendString("\r\n");
+            } else if (pattern_user_info(mode, &len, &crc) == 0) {
+                UART_SendString(": ");
+                UART_SendString(pattern_name(mode));
+                UART_SendString(", ");
+                uint32_to_str(len, str, sizeof(str));
+                UART_SendString(str);
+                UART_SendString(" B, CRC ");
+                CLI_SendHex16(crc);
+                UART_SendString("\r\n");
+            } else {
+                UART_SendString(": empty\r\n");
+            }
+        }
+    }
+    else if (strncmp(args, "load ", 5) == 0) {
+        char *end;
+        long mode = strtol(args + 5, &end, 10);
+        while (*end == ' ') end++;
+        bool b64 = (strcmp(end, "b64") == 0);
+        if (end == args + 5 || (*end && !b64 && strcmp(end, "hex") != 0)) {
+            UART_SendString("Usage: pat load <n> [hex|b64]\r\n");
+        } else if (mode < 0 || mode > 255 || pattern_load_begin((uint8_t)mode) != 0) {
+            UART_SendString("Invalid pattern slot\r\n");
+        } else {
+            pat_loading = true;
+            pat_load_b64 = b64;
+            uint32_to_str(PATTERN_USER_MAX, str, sizeof(str));
+            UART_SendString("Send up to ");
+            UART_SendString(str);
+            UART_SendString(b64 ? " B base64" : " B hex");
+            UART_SendString(", then 'end <crc16>' ('.' aborts)\r\n");
+        }
+    }
+    else if (strncmp(args, "del ", 4) == 0) {
+        int mode = atoi(args + 4);
+        if (mode >= 0 && pattern_delete((uint8_t)mode) == 0) {
+            UART_SendString("Pattern deleted\r\n");
+        } else {
+            UART_SendString("Invalid pattern slot\r\n");
+        }
+    }
+    else {
+        UART_SendString("Usage: pat [list] | pat load <n> [hex|b64] | pat del <n>\r\n");
+    }
+}
+
+/* One input line during 'pat load'. Data is decoded into a small chunk and
+   written through to storage, only the CLI line is ever buffered. */
+static void CLI_PatternLine(const char *line) {
+    uint8_t chunk[8];
+    uint8_t n = 0;
+    bool ok = true;
+
+    while (*line == ' ') line++;
+    if (strcmp(line, ".") == 0) {
+        pat_loading = false;
+        UART_SendString("Load aborted\r\n");
+        return;
+    }
+    if (strncmp(line, "end ", 4) == 0) {
+        char *end;
+        unsigned long crc = strtoul(line + 4, &end, 16);
+        pat_loading = false;
+        if (end == line + 4 || *end != '\0' || crc > 0xFFFFUL || pattern_load_end((uint16_t)crc) != 0) {
+            UART_SendString("Err: CRC mismatch, slot left empty\r\n");
+        } else {
+            UART_SendString("Pattern stored\r\n");
+        }
+        return;
+    }
+
+    while (ok && *line) {
+        if (*line == ' ') {
+            line++;
+            continue;
+        }
+        if (pat_load_b64) {
+            /* Four characters give up to three bytes; '=' pads the last group */
+            int v[4];
+            uint8_t pad = 0;
+            for (uint8_t i = 0; i < 4; i++) {
+                char c = line[i];
+                if (c == '=' && i >= 2) { v[i] = 0; pad++; }
+                else if (pad || (v[i] = b64_value(c)) < 0) { ok = false; break; }
+            }
+            if (!ok) break;
+            uint32_t q = ((uint32_t)v[0] << 18) | ((uint32_t)v[1] << 12) | ((uint32_t)v[2] << 6) | (uint32_t)v[3];
+            chunk[n++] = (uint8_t)(q >> 16);
+            if (pad < 2) chunk[n++] = (uint8_t)(q >> 8);
+            if (pad < 1) chunk[n++] = (uint8_t)q;
+            line += 4;
+        } else {
+            int hi = hex_value(line[0]);
+            int lo = (hi >= 0) ? hex_value(line[1]) : -1;
+            if (lo < 0) { ok = false; break; }
+            chunk[n++] = (uint8_t)((hi << 4) | lo);
+            line += 2;
+        }
+        if (n > sizeof(chunk) - 3) {
+            ok = (pattern_load_data(chunk, n) == 0);
+            n = 0;
+        }
+    }
+    if (ok && n) ok = (pattern_load_data(chunk, n) == 0);
+
+    if (!ok) {
+        pat_loading = false;
+        UART_SendString("Err: bad data or too long, load aborted\r\n");
+    }
+}
+
 static void CLI_Help(void) {
     UART_SendString("Available commands:\r\n");
     UART_SendString("  ver/version        - Firmware version\r\n");
     UART_SendString("  pwr                - Power source\r\n");
     UART_SendString("  led on/off/blink   - Debug LED ctrl\r\n");
     UART_SendString("  bled <1-5>/off     - Blink badge LED (bled off/stop to stop)\r\n");
-    UART_SendString("  bm/blinkmode [0-6] - Get/set auto-blink mode (0=OFF,1=BLINK,2=FADE,3=CW,4=STROBO,5=ICIRCLE,6=DISCO)\r\n");
+    UART_SendString("  bm/blinkmode [0-8] - Get/set auto-blink mode (0=OFF,1=BLINK,2=FADE,3=CW,4=STROBO,5=ICIRCLE,6=DISCO,7-8=user)\r\n");
+    UART_SendString("  pat [list]         - List user pattern slots\r\n");
+    UART_SendString("  pat load <n> [b64] - Upload pattern to slot n (hex or base64)\r\n");
+    UART_SendString("  pat del <n>        - Delete user pattern\r\n");
     UART_SendString("  status             - System status\r\n");
+    UART_SendString("  clock [eco|perf]   - CPU clock 12/48 MHz; clock perf <baud> for fast UART\r\n");
     UART_SendString("  uptime             - Show system uptime\r\n");
+#ifndef BOARD_SIM
+    UART_SendString("  mem                - RAM use, stack high-water mark\r\n");
+#endif
     UART_SendString("  ls                 - List files\r\n");
     UART_SendString("  cat <file>         - Show file\r\n");
-    UART_SendString("  cw <msg>           - Set/show CW message (1-20 chars)\r\n");
+    UART_SendString("  cw [<msg>|list]    - Set/show selected CW message, list all\r\n");
+    UART_SendString("  cw sel <n>         - Send CW message n (0-2)\r\n");
+    UART_SendString("  cw load <n>        - Enter long CW message n over several lines\r\n");
+    UART_SendString("  cw del <n>         - Delete CW message 1 or 2\r\n");
+    UART_SendString("  cwspeed [wpm [fw]] - Set/show CW speed (PARIS, Farnsworth)\r\n");
+    UART_SendString("  key [on|off|save]  - Button as straight key, decode/save as CW msg\r\n");
+    UART_SendString("  log [on|off|clear] - Binary log on the console (tools/logdecode.py)\r\n");
+    UART_SendString("  trace [dump|clear] - Event trace, kept over a reset\r\n");
+    UART_SendString("  boot [fast on|off] - Boot phase times; fast boot skips the delays\r\n");
     UART_SendString("  reset              - Factory reset\r\n");
     UART_SendString("  setcall/setnick <c>- Set callsign/nickname\r\n");
     UART_SendString("  who                - Show users\r\n");
-    UART_SendString("  dmesg              - Show boot messages\r\n");
+    UART_SendString("  dmesg              - Boot messages, reset cause, watchdog, fault\r\n");
     UART_SendString("  eeread <addr>      - Read byte from EEPROM addr\r\n");
     UART_SendString("  eewrite <addr> <d> - Write byte to EEPROM addr\r\n");
-    UART_SendString("  reboot             - Reboot\r\n\r\n");
+    UART_SendString("  reboot [dfu]       - Reboot, dfu: into the UART bootloader\r\n\r\n");
 }
 
-void CLI_ShowBootMessages(bool with_delays) {
+/* Boot message i, NULL past the last one */
+static const char *CLI_BootMessage(uint8_t i) {
     static const char * const msgs[] = {
         "\r\n\r\nSRAL-SAO2 fw v", FIRMWARE_VERSION, " booting...\r\n\r\n",
         "CPU clock 12 MHz... OK\r\n",
         "\r\nSystem ready. Type 'help' for help\r\n"
     };
-    static const uint8_t delays[] = {100,50,75,50,50,100,75,75,75,100,75,50,50,50,50,50,50,50,0};
-    
-    for (uint8_t i = 0; i < sizeof(msgs)/sizeof(msgs[0]); i++) {
-        UART_SendString(msgs[i]);
-        if (with_delays && delays[i]) delay_ms(delays[i]);
-    }
-    
-    /* Indicate if SAO UART was enabled at boot */
     extern bool uart2_enabled;
-    if (uart2_enabled) {
-        UART_SendString("SAO_IDC UART enabled (pin5/gpio1: RX, pin6/gpio2: TX)\r\n");
-        if (with_delays) delay_ms(50);
+
+    if (i < sizeof(msgs)/sizeof(msgs[0])) return msgs[i];
+    if (i > sizeof(msgs)/sizeof(msgs[0])) return NULL;
+    /* Indicate if SAO UART was enabled at boot */
+    return uart2_enabled ? "SAO_IDC UART enabled (pin5/gpio1: RX, pin6/gpio2: TX)\r\n"
+                         : "Hold BTN when powering on to enable SAO_IDC UART (pin5/gpio1: RX, pin6/gpio2: TX)\r\n";
+}
+
+void CLI_ShowBootMessages(bool with_delays) {
+    static const uint8_t delays[] = {100,50,75,50,50,50};
+    const char *msg;
+
+    for (uint8_t i = 0; (msg = CLI_BootMessage(i)) != NULL; i++) {
+        UART_SendString(msg);
+        if (with_delays && delays[i]) delay_ms(delays[i]);
     }
-    else {
-        UART_SendString("Hold BTN when powering on to enable SAO_IDC UART (pin5/gpio1: RX, pin6/gpio2: TX)\r\n");
-        if (with_delays) delay_ms(50);
+}
+
+/* Fast boot: the boot messages and the prompt still to send */
+static struct {
+    bool pending;
+    uint8_t msg;
+    uint8_t at;         /* Characters of msg already sent */
+} banner;
+
+void CLI_QueueBootMessages(void) {
+    banner.pending = true;
+    banner.msg = 0;
+    banner.at = 0;
+}
+
+uint32_t CLI_DrainBootMessages(uint32_t budget_us) {
+    uint32_t char_us = (10U * 1000000U) / UART_GetBaud();
+    uint32_t spent = 0;
+
+    /* Character by character, so a short budget still makes progress */
+    while (banner.pending && spent + char_us <= budget_us) {
+        const char *msg = CLI_BootMessage(banner.msg);
+        if (!msg) {
+            banner.pending = false;
+            CLI_PrintPrompt();
+            boot_mark(BOOT_READY);
+        } else if (msg[banner.at]) {
+            UART_SendChar(msg[banner.at++]);
+            spent += char_us;
+        } else {
+            banner.msg++;
+            banner.at = 0;
+        }
     }
+    return spent;
 }
 
 static void CLI_StartLedBlink(int led_num) {
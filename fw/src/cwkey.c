@@ -0,0 +1,156 @@
+/* Straight-key Morse decoder on the button */
+
+#include "cwkey.h"
+#include "morse.h"
+#include "gpio.h"
+#include "pins.h"
+#include "uart.h"
+#include "timer.h"
+#include <string.h>
+
+#define CWKEY_RING          8       /* Edges between two main loop passes */
+#define CWKEY_DIT_INIT_US   100000U /* 12 wpm until the first elements are keyed */
+#define CWKEY_DIT_MIN_US    30000U  /* 40 wpm */
+#define CWKEY_DIT_MAX_US    400000U /* 3 wpm */
+#define CWKEY_CODE_MAX      7       /* Elements in the longest code */
+
+/* Filled by the EXTI interrupt, drained by cwkey_tick() */
+static struct {
+    uint32_t t[CWKEY_RING];
+    uint8_t down;                   /* Bit i: edge i is a press */
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    uint32_t last_t;                /* Last accepted edge */
+} ring;
+
+static struct {
+    bool active;
+    bool down;
+    uint32_t t;                     /* Time of the last edge */
+    uint32_t dit_us;
+    uint8_t code;                   /* Packed as in morse_code(), 1 = none yet */
+    uint8_t elements;
+    bool word_sent;                 /* Space after the last word already added */
+    uint8_t len;
+    char text[CWKEY_TEXT_MAX + 1];
+} key;
+
+void cwkey_start(void) {
+    ring.head = ring.tail = 0;
+    ring.last_t = micros();
+    key.down = false;
+    key.t = ring.last_t;
+    key.dit_us = CWKEY_DIT_INIT_US;
+    key.code = 1;
+    key.elements = 0;
+    key.word_sent = true;
+    key.active = true;      /* EXTI already fires on both edges for button.c */
+}
+
+void cwkey_stop(void) {
+    key.active = false;
+    PIN_CLEAR(LED);
+}
+
+bool cwkey_active(void) {
+    return key.active;
+}
+
+void cwkey_edge(bool down, uint32_t t_us) {
+    /* Bounce: too soon after the last accepted edge. A real edge lost this
+       way is picked up by the level check in cwkey_tick(), repeated levels
+       are dropped there. */
+    if (t_us - ring.last_t < CWKEY_DEBOUNCE_US) return;
+    uint8_t next = (uint8_t)((ring.head + 1U) % CWKEY_RING);
+    if (next == ring.tail) return;
+    ring.t[ring.head] = t_us;
+    if (down) ring.down |= (uint8_t)(1U << ring.head);
+    else ring.down &= (uint8_t)~(1U << ring.head);
+    ring.head = next;
+    ring.last_t = t_us;
+    /* Debug LED follows the key */
+    if (down) PIN_SET(LED); else PIN_CLEAR(LED);
+}
+
+static void add_char(char c) {
+    if (key.len == CWKEY_TEXT_MAX) {
+        memmove(key.text, key.text + 1, CWKEY_TEXT_MAX - 1);
+        key.len--;
+    }
+    key.text[key.len++] = c;
+    key.text[key.len] = '\0';
+    UART_SendChar(c);
+}
+
+/* Key up since key.t: close the character after 2 dits, the word after 5.
+   t can be behind key.t: the caller's time was taken before an edge that
+   the interrupt queued since, so the gap is signed. */
+static void space_until(uint32_t t) {
+    int32_t gap = (int32_t)(t - key.t);
+
+    if (gap <= 0) return;
+    if (key.elements && (uint32_t)gap >= 2U * key.dit_us) {
+        char c = (key.elements > CWKEY_CODE_MAX) ? 0 : morse_char(key.code);
+        add_char(c ? c : '*');
+        key.code = 1;
+        key.elements = 0;
+        key.word_sent = false;
+    }
+    if (!key.word_sent && !key.elements && (uint32_t)gap >= 5U * key.dit_us) {
+        add_char(' ');
+        key.word_sent = true;
+    }
+}
+
+/* Key down since key.t, released at t: a dit below 2 dits, else a dah.
+   The estimate follows each element with a quarter of the difference. */
+static void mark_until(uint32_t t) {
+    uint32_t mark = t - key.t;
+    bool dah = mark >= 2U * key.dit_us;
+    uint32_t dit = dah ? mark / 3U : mark;
+
+    key.dit_us = (3U * key.dit_us + dit) / 4U;
+    if (key.dit_us < CWKEY_DIT_MIN_US) key.dit_us = CWKEY_DIT_MIN_US;
+    if (key.dit_us > CWKEY_DIT_MAX_US) key.dit_us = CWKEY_DIT_MAX_US;
+    if (key.elements < CWKEY_CODE_MAX) key.code = (uint8_t)((key.code << 1) | (dah ? 1U : 0U));
+    key.elements++;
+}
+
+static void apply_edge(bool down, uint32_t t) {
+    if (down == key.down) return;
+    if (down) space_until(t); else mark_until(t);
+    key.down = down;
+    key.t = t;
+}
+
+void cwkey_tick(uint32_t now_us) {
+    if (!key.active) return;
+
+    while (ring.tail != ring.head) {
+        uint8_t i = ring.tail;
+        apply_edge((ring.down >> i) & 1U, ring.t[i]);
+        ring.tail = (uint8_t)((i + 1U) % CWKEY_RING);
+    }
+    /* Pin settled at a level the queue does not show (edge lost as bounce);
+       signed, as now_us can be older than the edges just applied */
+    bool level_down = (PIN_READ(BTN) == 0);
+    if (level_down != key.down && (int32_t)(now_us - key.t) >= (int32_t)CWKEY_DEBOUNCE_US &&
+        (int32_t)(now_us - ring.last_t) >= (int32_t)CWKEY_DEBOUNCE_US) {
+        apply_edge(level_down, now_us);
+        if (level_down) PIN_SET(LED); else PIN_CLEAR(LED);
+    }
+    if (!key.down) space_until(now_us);
+}
+
+const char *cwkey_text(void) {
+    return key.text;
+}
+
+void cwkey_clear(void) {
+    key.len = 0;
+    key.text[0] = '\0';
+}
+
+uint8_t cwkey_wpm(void) {
+    return (uint8_t)((1200000U + key.dit_us / 2U) / key.dit_us);
+}
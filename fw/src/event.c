@@ -0,0 +1,54 @@
+/* Interrupt to main loop event queue */
+
+#include "event.h"
+#include "config.h"
+#include "irq.h"
+#include "system.h"
+#include "log.h"
+
+/* head: producers, under the mask; tail: the main loop only */
+static struct {
+    event_t ev[EVENT_QUEUE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+} queue;
+
+RAMFUNC int event_post(uint8_t type, uint8_t source, uint16_t data, uint32_t t_us) {
+    uint32_t primask = irq_save();
+    uint8_t i = queue.head;
+    uint8_t next = (uint8_t)((i + 1U) % EVENT_QUEUE);
+    if (next == queue.tail) {
+        irq_restore(primask);
+        LOG("event: type %u from %u lost, queue full", type, source);
+        return -1;
+    }
+    queue.ev[i] = (event_t){ type, source, data, t_us };
+    queue.head = next;
+    irq_restore(primask);
+    return 0;
+}
+
+bool event_get(event_t *ev) {
+    uint8_t i = queue.tail;
+    if (i == queue.head) return false;
+    *ev = queue.ev[i];
+    queue.tail = (uint8_t)((i + 1U) % EVENT_QUEUE);    /* Frees the entry */
+    return true;
+}
+
+bool event_pending(void) {
+    return queue.tail != queue.head;
+}
+
+void event_wait(void) {
+    /* Check and sleep with interrupts masked: WFI still wakes on the pending
+       interrupt, which then runs once the mask is lifted, so a post between
+       the check and the sleep is never slept through */
+    uint32_t primask = irq_save();
+    while (queue.tail == queue.head) {
+        System_Sleep();
+        irq_restore(primask);
+        primask = irq_save();
+    }
+    irq_restore(primask);
+}
@@ -0,0 +1,135 @@
+/* HardFault post-mortem record and boot counter */
+
+#include "fault.h"
+#include "config.h"
+#include "trace.h"
+#include <stddef.h>
+
+#ifndef BOARD_SIM
+#include "stm32c011xx.h"
+
+#define FAULT_NOINIT    __attribute__((section(".noinit.fault")))
+#else
+#define FAULT_NOINIT
+#endif
+
+#define FAULT_MAGIC         0x464C5431UL    /* "FLT1" */
+
+/* First in .noinit (STM32C011F6P6.ld), so it stays at the same address from
+   one build to the next and a debugger finds it too */
+static struct {
+    uint32_t magic;
+    uint32_t boots;
+    uint32_t faults;
+    fault_record_t fault;
+} rec FAULT_NOINIT;
+
+static uint8_t reset_flags;
+
+void fault_init(void) {
+#ifndef BOARD_SIM
+    reset_flags = (uint8_t)(RCC->CSR2 >> 24);
+    RCC->CSR2 |= RCC_CSR2_RMVF;
+#else
+    reset_flags = FAULT_RESET_POWER | FAULT_RESET_PIN;
+#endif
+    /* SRAM contents after power-on or brown-out mean nothing */
+    if (rec.magic != FAULT_MAGIC || (reset_flags & FAULT_RESET_POWER)) {
+        rec.magic = FAULT_MAGIC;
+        rec.boots = 0;
+        rec.faults = 0;
+    }
+    rec.boots++;
+}
+
+uint32_t fault_boots(void) {
+    return rec.boots;
+}
+
+uint32_t fault_count(void) {
+    return rec.faults;
+}
+
+uint8_t fault_reset_flags(void) {
+    return reset_flags;
+}
+
+const char *fault_reset_cause(void) {
+    /* Internal resets drive NRST as well: the pin flag comes last */
+    static const struct {
+        uint8_t flag;
+        const char *name;
+    } causes[] = {
+        { FAULT_RESET_LOWPOWER, "low-power" },
+        { FAULT_RESET_WWDG, "window watchdog" },
+        { FAULT_RESET_IWDG, "watchdog" },
+        { FAULT_RESET_SOFTWARE, "software" },
+        { FAULT_RESET_POWER, "power-on" },
+        { FAULT_RESET_OPTION, "option bytes" },
+        { FAULT_RESET_PIN, "reset pin" },
+    };
+    for (size_t i = 0; i < sizeof(causes) / sizeof(causes[0]); i++) {
+        if (reset_flags & causes[i].flag) return causes[i].name;
+    }
+    return "unknown";
+}
+
+const fault_record_t *fault_last(void) {
+    return rec.faults ? &rec.fault : NULL;
+}
+
+#ifndef BOARD_SIM
+extern uint32_t _estack;
+
+static bool in_sram(const uint32_t *p, uint32_t bytes) {
+    uint32_t a = (uint32_t)p;
+    return a >= SRAM_BASE && (a & 3U) == 0 && a + bytes <= (uint32_t)&_estack;
+}
+
+/* Called by HardFault_Handler with the exception frame. A frame outside
+   SRAM (stack overflow) still gets the fault counted, with zero registers */
+__attribute__((used, noreturn)) void fault_capture(const uint32_t *frame, uint32_t exc_return) {
+    fault_record_t *f = &rec.fault;
+    static const uint32_t none[8];
+
+    if (!in_sram(frame, 32U)) frame = none;
+    f->r0 = frame[0];
+    f->r1 = frame[1];
+    f->r2 = frame[2];
+    f->r3 = frame[3];
+    f->r12 = frame[4];
+    f->lr = frame[5];
+    f->pc = frame[6];
+    f->xpsr = frame[7];
+    /* xPSR bit 9: a padding word was pushed to align the frame */
+    f->sp = (frame == none) ? 0 : (uint32_t)frame + 32U + ((f->xpsr & (1U << 9)) ? 4U : 0U);
+    for (uint8_t i = 0; i < FAULT_STACK_WORDS; i++) {
+        const uint32_t *p = (const uint32_t *)f->sp + i;
+        f->stack[i] = in_sram(p, 4U) ? *p : 0;
+    }
+    f->exc_return = exc_return;
+    f->boot = rec.boots;
+    rec.faults++;
+    trace(TRACE_FAULT, 0, (uint16_t)f->pc);
+
+    NVIC_SystemReset();
+    while (1);
+}
+
+/* The frame is on the stack that was in use: bit 2 of EXC_RETURN */
+__attribute__((naked)) void HardFault_Handler(void) {
+    __asm volatile(
+        "movs r0, #4        \n"
+        "mov  r1, lr        \n"
+        "tst  r0, r1        \n"
+        "beq  1f            \n"
+        "mrs  r0, psp       \n"
+        "b    2f            \n"
+        "1:                 \n"
+        "mrs  r0, msp       \n"
+        "2:                 \n"
+        "ldr  r2, =fault_capture \n"
+        "bx   r2            \n"
+        ".ltorg             \n");
+}
+#endif
@@ -0,0 +1,59 @@
+/* Flash program/erase driver for STM32C0 (single bank, 2 KB pages) */
+
+#include "flash.h"
+#include "stm32c011xx.h"
+
+#define FLASH_KEY1      0x45670123UL
+#define FLASH_KEY2      0xCDEF89ABUL
+
+/* Error flags in FLASH->SR, cleared by writing 1 */
+#define FLASH_SR_ERRORS (FLASH_SR_OPERR | FLASH_SR_PROGERR | FLASH_SR_WRPERR | \
+                         FLASH_SR_PGAERR | FLASH_SR_SIZERR | FLASH_SR_PGSERR | \
+                         FLASH_SR_MISERR | FLASH_SR_FASTERR)
+
+static void flash_wait(void) {
+    while (FLASH->SR & FLASH_SR_BSY1);
+}
+
+static int flash_result(void) {
+    uint32_t sr = FLASH->SR;
+    FLASH->SR = (sr & FLASH_SR_ERRORS) | FLASH_SR_EOP;
+    return (sr & FLASH_SR_ERRORS) ? -1 : 0;
+}
+
+void Flash_Unlock(void) {
+    if (FLASH->CR & FLASH_CR_LOCK) {
+        FLASH->KEYR = FLASH_KEY1;
+        FLASH->KEYR = FLASH_KEY2;
+    }
+}
+
+void Flash_Lock(void) {
+    FLASH->CR |= FLASH_CR_LOCK;
+}
+
+int Flash_ErasePage(const void *page) {
+    uint32_t pnb = ((uint32_t)page - FLASH_BASE) / FLASH_EMU_PAGE_SIZE;
+
+    flash_wait();
+    FLASH->SR = FLASH_SR_ERRORS;
+    FLASH->CR = (FLASH->CR & ~FLASH_CR_PNB) | (pnb << FLASH_CR_PNB_Pos) | FLASH_CR_PER;
+    FLASH->CR |= FLASH_CR_STRT;
+    flash_wait();
+    FLASH->CR &= ~(FLASH_CR_PER | FLASH_CR_PNB);
+    return flash_result();
+}
+
+int Flash_ProgramDoubleWord(const void *addr, uint32_t lo, uint32_t hi) {
+    volatile uint32_t *dst = (volatile uint32_t *)addr;
+
+    flash_wait();
+    FLASH->SR = FLASH_SR_ERRORS;
+    FLASH->CR |= FLASH_CR_PG;
+    dst[0] = lo;
+    __ISB();
+    dst[1] = hi;    /* Second word starts the 64-bit program operation */
+    flash_wait();
+    FLASH->CR &= ~FLASH_CR_PG;
+    return flash_result();
+}
@@ -3,15 +3,9 @@
 #include "gpio.h"
 #include "stm32c011xx.h"
 
-/* Enable GPIO clocks for STM32C0 series (IOPENR register) */
+/* Enable GPIO clocks for STM32C0 series (IOPENR register); unknown ports are ignored */
 void GPIO_ClockEnable(void *port) {
-    if (port == GPIOA) RCC->IOPENR |= RCC_IOPENR_GPIOAEN;
-    else if (port == GPIOB) RCC->IOPENR |= RCC_IOPENR_GPIOBEN;
-    else if (port == GPIOC) RCC->IOPENR |= RCC_IOPENR_GPIOCEN;
-    else {
-        /* Some small devices may not have all ports; ignore unknown ports */
-        (void)port;
-    }
+    gpio_clock_enable(port);
 }
 
 void GPIO_SetMode(void *port, uint8_t pin, GPIO_Mode_t mode) {
@@ -50,21 +44,70 @@ void GPIO_SetAlternateFunction(void *port, uint8_t pin, uint8_t af) {
 }
 
 void GPIO_SetPin(void *port, uint8_t pin) {
-    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
-    gpio->BSRR = (1U << pin);
+    gpio_set(port, pin);
 }
 
 void GPIO_ClearPin(void *port, uint8_t pin) {
-    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
-    gpio->BSRR = (1U << (pin + 16));
+    gpio_clear(port, pin);
 }
 
 void GPIO_TogglePin(void *port, uint8_t pin) {
-    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
-    gpio->ODR ^= (1U << pin);
+    gpio_toggle(port, pin);
 }
 
 uint8_t GPIO_ReadPin(void *port, uint8_t pin) {
-    GPIO_TypeDef *gpio = (GPIO_TypeDef *)port;
-    return (gpio->IDR & (1U << pin)) ? 1 : 0;
+    return gpio_read(port, pin);
+}
+
+void GPIO_WriteBSRR(void *port, uint32_t bsrr) {
+    gpio_bsrr(port, bsrr);
+}
+
+void GPIO_EnableIRQ(void *port, uint8_t pin, GPIO_Edge_t edge) {
+    uint32_t bit = 1UL << pin;
+    uint32_t shift = (pin % 4U) * 8U;
+    uint32_t port_code = (port == GPIOB) ? 1U : (port == GPIOC) ? 2U : 0U;
+    IRQn_Type irq = (pin < 2) ? EXTI0_1_IRQn : (pin < 4) ? EXTI2_3_IRQn : EXTI4_15_IRQn;
+
+    RCC->APBENR2 |= RCC_APBENR2_SYSCFGEN;
+    EXTI->EXTICR[pin / 4U] = (EXTI->EXTICR[pin / 4U] & ~(0xFFUL << shift)) | (port_code << shift);
+    EXTI->IMR1 |= bit;
+    if (edge & GPIO_EDGE_FALLING) EXTI->FTSR1 |= bit; else EXTI->FTSR1 &= ~bit;
+    if (edge & GPIO_EDGE_RISING) EXTI->RTSR1 |= bit; else EXTI->RTSR1 &= ~bit;
+    EXTI->RPR1 = bit;   /* Clear any existing pending bits */
+    EXTI->FPR1 = bit;
+    NVIC_ClearPendingIRQ(irq);
+    NVIC_EnableIRQ(irq);
+}
+
+__attribute__((weak)) void GPIO_EXTI_Callback(uint8_t pin, GPIO_Edge_t edge) {
+    (void)pin;
+    (void)edge;
+}
+
+/* Clear pending EXTI lines first..last and dispatch them to the callback */
+static void GPIO_EXTI_Dispatch(uint8_t first, uint8_t last) {
+    for (uint8_t pin = first; pin <= last; pin++) {
+        uint32_t bit = 1UL << pin;
+        if (EXTI->FPR1 & bit) {
+            EXTI->FPR1 = bit;
+            GPIO_EXTI_Callback(pin, GPIO_EDGE_FALLING);
+        }
+        if (EXTI->RPR1 & bit) {
+            EXTI->RPR1 = bit;
+            GPIO_EXTI_Callback(pin, GPIO_EDGE_RISING);
+        }
+    }
+}
+
+void EXTI0_1_IRQHandler(void) {
+    GPIO_EXTI_Dispatch(0, 1);
+}
+
+void EXTI2_3_IRQHandler(void) {
+    GPIO_EXTI_Dispatch(2, 3);
+}
+
+void EXTI4_15_IRQHandler(void) {
+    GPIO_EXTI_Dispatch(4, 15);
 }
@@ -0,0 +1,113 @@
+/* Pin API benchmark, built with ENABLE_GPIO_BENCH (config.h)
+ *
+ * Times the LED hot paths with the SysTick down-counter, which runs at the
+ * core clock: the out-of-line GPIO_* wrappers against the inline pin API, and
+ * led_write_mask() (the BCM interrupt's frame write) against the same table
+ * written through GPIO_WriteBSRR() in a port loop, as it was before the
+ * inline API. Each figure is the fastest of BENCH_RUNS calls minus the cost
+ * of an empty call. LED1..LED5 flicker while it runs.
+ *
+ * The interrupt lines time the handler bodies that RAMFUNC moves to SRAM and
+ * say where they run from; compare a default build with 'make RAMFUNC=0',
+ * both after 'clock perf', where flash has a wait state.
+ */
+
+#include "config.h"
+
+#if ENABLE_GPIO_BENCH
+
+#include "gpio.h"
+#include "led.h"
+#include "pins.h"
+#include "uart.h"
+#include "timer.h"
+#include "system.h"
+#include "stm32c011xx.h"
+
+#define BENCH_RUNS  8
+
+typedef void (*bench_fn_t)(void);
+
+static GPIO_TypeDef *const bench_ports[3] = { GPIOA, GPIOB, GPIOC };
+
+static __attribute__((noinline)) void bench_empty(void) { }
+static __attribute__((noinline)) void bench_set_wrapper(void) { GPIO_SetPin(LED1_GPIO_PORT, LED1_GPIO_PIN); }
+static __attribute__((noinline)) void bench_set_inline(void) { PIN_SET(LED1); }
+static __attribute__((noinline)) void bench_clear_wrapper(void) { GPIO_ClearPin(LED1_GPIO_PORT, LED1_GPIO_PIN); }
+static __attribute__((noinline)) void bench_clear_inline(void) { PIN_CLEAR(LED1); }
+
+static __attribute__((noinline)) void bench_frame_wrapper(void) {
+    const uint32_t *w = led_mask_bsrr(0x15);
+    for (uint8_t p = 0; p < 3; p++) {
+        if (w[p]) GPIO_WriteBSRR(bench_ports[p], w[p]);
+    }
+}
+
+static __attribute__((noinline)) void bench_frame_inline(void) { led_write_mask(0x15); }
+
+void TIM14_IRQHandler(void);
+
+/* One BCM plane as the interrupt runs it (the timer itself may be stopped),
+   the time base every delay polls, and a UART interrupt with no data */
+static __attribute__((noinline)) void bench_plane(void) { TIM14_IRQHandler(); }
+static __attribute__((noinline)) void bench_micros(void) { (void)micros(); }
+static __attribute__((noinline)) void bench_uart_irq(void) { UART_IRQHandler(); }
+
+static uint32_t bench_cycles(bench_fn_t fn) {
+    uint32_t best = 0xFFFFFFFFUL;
+    for (uint8_t i = 0; i < BENCH_RUNS; i++) {
+        __disable_irq();
+        uint32_t start = SysTick->VAL;
+        fn();
+        uint32_t end = SysTick->VAL;
+        __enable_irq();
+        /* Down-counter: add one period when it reloaded in between */
+        uint32_t elapsed = (start >= end) ? start - end : start + SysTick->LOAD + 1U - end;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+static void bench_send_dec(uint32_t v) {
+    char buf[11];
+    uint8_t i = sizeof(buf) - 1;
+    buf[i] = '\0';
+    do {
+        buf[--i] = (char)('0' + v % 10U);
+        v /= 10U;
+    } while (v && i);
+    UART_SendString(&buf[i]);
+}
+
+static void bench_line(const char *name, bench_fn_t wrapper, bench_fn_t inlined, uint32_t base) {
+    UART_SendString(name);
+    UART_SendString(" wrapper ");
+    bench_send_dec(bench_cycles(wrapper) - base);
+    UART_SendString(", inline ");
+    bench_send_dec(bench_cycles(inlined) - base);
+    UART_SendString(" cycles\r\n");
+}
+
+static void bench_code(const char *name, bench_fn_t fn, void (*code)(void), uint32_t base) {
+    UART_SendString(name);
+    UART_SendString(" ");
+    bench_send_dec(bench_cycles(fn) - base);
+    /* SRAM starts at 0x20000000, flash at 0x08000000 */
+    UART_SendString((uint32_t)code >= 0x20000000UL ? " cycles, SRAM\r\n" : " cycles, flash\r\n");
+}
+
+void GPIO_Bench(void) {
+    uint32_t base = bench_cycles(bench_empty);
+
+    bench_send_dec(System_GetClock() / 1000000U);
+    UART_SendString(" MHz\r\n");
+
+    bench_line("LED1 set  ", bench_set_wrapper, bench_set_inline, base);
+    bench_line("LED1 clear", bench_clear_wrapper, bench_clear_inline, base);
+    bench_line("LED frame ", bench_frame_wrapper, bench_frame_inline, base);
+    bench_code("BCM plane ISR", bench_plane, TIM14_IRQHandler, base);
+    bench_code("micros()     ", bench_micros, (void (*)(void))micros, base);
+    bench_code("UART ISR idle", bench_uart_irq, UART_IRQHandler, base);
+}
+
+#endif /* ENABLE_GPIO_BENCH */
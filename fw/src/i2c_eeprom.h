@@ -6,9 +6,19 @@
 
 #include <stdint.h>
 
+/* 24C02 geometry: page writes must not cross an 8-byte page boundary */
+#define EEPROM_SIZE             256U
+#define EEPROM_PAGE_SIZE        8U
+#define EEPROM_WRITE_CYCLE_US   5000U   /* tWR, one per byte or page write */
+
 void eeprom_init(void);
 int eeprom_write_byte(uint16_t mem_addr, uint8_t data);
 int eeprom_read_byte(uint16_t mem_addr, uint8_t *data);
+/* Sequential read of len bytes starting at mem_addr */
+int eeprom_read_block(uint16_t mem_addr, uint8_t *buf, uint16_t len);
+/* Differential write: reads each page first and only page-writes the bytes that
+   differ. Stores the number of bytes actually written in *written (may be NULL). */
+int eeprom_update_block(uint16_t mem_addr, const uint8_t *data, uint16_t len, uint16_t *written);
 uint32_t eeprom_get_last_isr(void);
 uint32_t eeprom_get_cr2(void);
 uint32_t eeprom_get_timing(void);
@@ -1,6 +1,8 @@
 /* LED control functions */
 
 #include "led.h"
+#include "config.h"
+#include "irq.h"
 #include "gpio.h"
 #include "pins.h"
 #include "timer.h"
@@ -10,35 +12,58 @@
 static LED_Mode_t led_mode = LED_MODE_OFF;
 static uint32_t last_blink_time = 0;
 
-/* LED auto-blink mode names: 0=OFF, 1=BLINK, 2=FADE, 3=CW, 4=STROBO, 5=ICIRCLE, 6=DISCO */
-const char *led_blink_mode_names[7] = {"OFF", "BLINK", "FADE", "CW", "STROBO", "ICIRCLE", "DISCO"};
+/* BSRR word for one port and LED mask: set the lit LEDs on that port, reset the others */
+#define LED_BIT(port, n, mask) \
+    ((LED##n##_GPIO_PORT == (port)) ? \
+     (((mask) & (1U << ((n) - 1))) ? (1UL << LED##n##_GPIO_PIN) : (1UL << (LED##n##_GPIO_PIN + 16))) : 0UL)
+#define LED_BSRR(port, mask) \
+    (LED_BIT(port, 1, mask) | LED_BIT(port, 2, mask) | LED_BIT(port, 3, mask) | \
+     LED_BIT(port, 4, mask) | LED_BIT(port, 5, mask))
+#define LED_FRAME(mask)     { LED_BSRR(GPIOA, mask), LED_BSRR(GPIOB, mask), LED_BSRR(GPIOC, mask) }
+#define LED_FRAMES4(mask)   LED_FRAME(mask), LED_FRAME(mask + 1), LED_FRAME(mask + 2), LED_FRAME(mask + 3)
+
+#define LED_PORTS   3
+
+/* Ports that carry no LED are never written */
+#define LED_ON_PORT(port)   (LED_BSRR(port, LED_MASK_ALL) != 0UL)
+
+static const uint32_t led_frames[LED_MASK_ALL + 1][LED_PORTS] = {
+    LED_FRAMES4(0),  LED_FRAMES4(4),  LED_FRAMES4(8),  LED_FRAMES4(12),
+    LED_FRAMES4(16), LED_FRAMES4(20), LED_FRAMES4(24), LED_FRAMES4(28),
+};
+
+/* Mask actually shown for each requested mask, rebuilt by led_set_max_lit() */
+#define LED_SAME4(mask)     (mask), (mask) + 1, (mask) + 2, (mask) + 3
+static uint8_t led_allowed[LED_MASK_ALL + 1] = {
+    LED_SAME4(0),  LED_SAME4(4),  LED_SAME4(8),  LED_SAME4(12),
+    LED_SAME4(16), LED_SAME4(20), LED_SAME4(24), LED_SAME4(28),
+};
+
+/* The frame on the pins is the engine's last mask (BCM plane or CW element)
+   with the blinker LEDs on top, capped through led_allowed */
+static volatile uint8_t led_engine;
+static volatile uint8_t led_blink;
 
 void LED_Init(void) {
-    /* Enable GPIO clock */
-    GPIO_ClockEnable(LED_GPIO_PORT);
-    
-    /* Configure LED pin as output */
-    GPIO_SetMode(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_MODE_OUTPUT);
-    GPIO_SetOutputType(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_OTYPE_PP);
-    GPIO_SetSpeed(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_SPEED_LOW);
-    GPIO_SetPullUpDown(LED_GPIO_PORT, LED_GPIO_PIN, GPIO_PUPD_NONE);
+    /* Enable GPIO clock and configure LED pin as output */
+    PIN_OUTPUT(LED, GPIO_SPEED_LOW);
     
     /* Start with LED off */
     LED_Off();
 }
 
 void LED_On(void) {
-    GPIO_SetPin(LED_GPIO_PORT, LED_GPIO_PIN);
+    PIN_SET(LED);
     led_mode = LED_MODE_ON;
 }
 
 void LED_Off(void) {
-    GPIO_ClearPin(LED_GPIO_PORT, LED_GPIO_PIN);
+    PIN_CLEAR(LED);
     led_mode = LED_MODE_OFF;
 }
 
 void LED_Toggle(void) {
-    GPIO_TogglePin(LED_GPIO_PORT, LED_GPIO_PIN);
+    PIN_TOGGLE(LED);
 }
 
 void LED_SetMode(LED_Mode_t mode) {
@@ -67,3 +92,37 @@ void LED_Update(void) {
         }
     }
 }
+
+const uint32_t *led_mask_bsrr(uint8_t mask) {
+    return led_frames[mask & LED_MASK_ALL];
+}
+
+void led_set_max_lit(uint8_t n) {
+    for (uint8_t mask = 0; mask <= LED_MASK_ALL; mask++) {
+        uint8_t keep = 0, count = 0;
+        for (uint8_t i = 0; i < 5U; i++) {
+            if ((mask & (1U << i)) && count < n) {
+                keep |= (uint8_t)(1U << i);
+                count++;
+            }
+        }
+        led_allowed[mask] = keep;
+    }
+    led_write_bits(0, 0);       /* Show the current frame under the new cap */
+}
+
+RAMFUNC void led_write_mask(uint8_t mask) {
+    led_engine = mask;
+    const uint32_t *w = led_frames[led_allowed[(mask | led_blink) & LED_MASK_ALL]];
+    if (LED_ON_PORT(GPIOA)) gpio_bsrr(GPIOA, w[0]);
+    if (LED_ON_PORT(GPIOB)) gpio_bsrr(GPIOB, w[1]);
+    if (LED_ON_PORT(GPIOC)) gpio_bsrr(GPIOC, w[2]);
+}
+
+void led_write_bits(uint8_t mask, uint8_t which) {
+    /* Masked, so an engine write cannot come between and be overwritten */
+    uint32_t primask = irq_save();
+    led_blink = (uint8_t)((led_blink & ~which) | (mask & which));
+    led_write_mask(led_engine);
+    irq_restore(primask);
+}
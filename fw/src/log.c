@@ -0,0 +1,125 @@
+/* Deferred binary log */
+
+#include "log.h"
+#include "config.h"
+#include "irq.h"
+#include "uart.h"
+
+#define LOG_PAYLOAD_MAX     (2U + 5U * (1U + LOG_ARGS_MAX))
+
+/* Start of the format strings; the linker script defines it on the target,
+   the host linker for any section named like a C identifier */
+extern const char __start_log_fmt[];
+
+/* Records in the ring are a length byte and the payload. head and last_us:
+   producers, under the mask; tail: the main loop only */
+static struct {
+    uint8_t buf[LOG_RING_SIZE];
+    volatile uint16_t head;
+    volatile uint16_t tail;
+    uint32_t last_us;
+    uint32_t records;
+    uint32_t dropped;
+    bool enabled;
+} ring;
+
+static uint8_t put_varint(uint8_t *p, uint32_t v) {
+    uint8_t n = 0;
+    while (v >= 0x80U) {
+        p[n++] = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+RAMFUNC void log_write(const char *fmt, const uint32_t *args, size_t n) {
+    uint8_t rec[1U + LOG_PAYLOAD_MAX];
+    uint16_t id = (uint16_t)(fmt - __start_log_fmt);
+    uint8_t len = 3;
+
+    rec[1] = (uint8_t)id;
+    rec[2] = (uint8_t)(id >> 8);
+    for (size_t i = 0; i < n; i++) len += put_varint(&rec[len], args[i]);
+
+    /* Timestamp and insert under the mask: the time is relative to the
+       record queued before this one */
+    uint32_t primask = irq_save();
+    uint32_t now = irq_now_us();
+    uint8_t end = len + put_varint(&rec[len], now - ring.last_us);
+    rec[0] = (uint8_t)(end - 1U);
+
+    uint16_t head = ring.head;
+    uint16_t used = (uint16_t)((head - ring.tail + LOG_RING_SIZE) % LOG_RING_SIZE);
+    if (used + end >= LOG_RING_SIZE) {
+        ring.dropped++;
+        irq_restore(primask);
+        return;
+    }
+    for (uint8_t i = 0; i < end; i++) {
+        ring.buf[head] = rec[i];
+        head = (uint16_t)((head + 1U) % LOG_RING_SIZE);
+    }
+    ring.head = head;
+    ring.last_us = now;
+    ring.records++;
+    irq_restore(primask);
+}
+
+uint32_t log_drain(uint32_t budget_us) {
+    uint32_t char_us = (10U * 1000000U) / UART_GetBaud();
+    uint32_t spent = 0;
+
+    while (ring.enabled && ring.tail != ring.head) {
+        uint8_t frame[2U + 1U + LOG_PAYLOAD_MAX];
+        uint16_t tail = ring.tail;
+        uint8_t len = ring.buf[tail];
+
+        /* 0x00, COBS code bytes in place of each zero and one at the start */
+        if ((uint32_t)(len + 3U) * char_us > budget_us - spent) break;
+        uint8_t code_at = 1;
+        uint8_t n = 2;
+        frame[0] = 0x00;
+        for (uint8_t i = 0; i < len; i++) {
+            tail = (uint16_t)((tail + 1U) % LOG_RING_SIZE);
+            uint8_t b = ring.buf[tail];
+            if (b == 0x00) {
+                frame[code_at] = (uint8_t)(n - code_at);
+                code_at = n++;
+            } else {
+                frame[n++] = b;
+            }
+        }
+        frame[code_at] = (uint8_t)(n - code_at);
+        frame[n++] = 0x00;
+        ring.tail = (uint16_t)((tail + 1U) % LOG_RING_SIZE);   /* Frees the record */
+
+        UART_SendData(frame, n);
+        spent += n * char_us;
+    }
+    return spent;
+}
+
+void log_enable(bool on) {
+    ring.enabled = on;
+}
+
+bool log_enabled(void) {
+    return ring.enabled;
+}
+
+void log_clear(void) {
+    ring.tail = ring.head;
+}
+
+uint32_t log_records(void) {
+    return ring.records;
+}
+
+uint32_t log_dropped(void) {
+    return ring.dropped;
+}
+
+uint16_t log_pending(void) {
+    return (uint16_t)((ring.head - ring.tail + LOG_RING_SIZE) % LOG_RING_SIZE);
+}
@@ -0,0 +1,58 @@
+/* Stack painting and RAM use */
+
+#include "mem.h"
+#include "trace.h"
+#include "log.h"
+#include "stm32c011xx.h"
+
+/* Linker script symbols */
+extern uint32_t _sdata, _edata, _sramfunc, _eramfunc, _sbss, _ebss;
+extern uint32_t _snoinit, _enoinit, _end, _estack, _Min_Stack_Size;
+
+static uint32_t *stack_limit(void) {
+    return (uint32_t *)((uint32_t)&_estack - (uint32_t)&_Min_Stack_Size);
+}
+
+/* The heap only grows: the paint above its end is the stack's */
+static uint32_t *heap_end(void) {
+    return (uint32_t *)(((uint32_t)&_end + sbrk_used() + 3U) & ~3U);
+}
+
+void mem_paint(void) {
+    /* No interrupt source is enabled yet (PRIMASK is clear, but nothing can
+       fire), so nothing else uses the stack: a few words below the SP do */
+    uint32_t *sp = (uint32_t *)(__get_MSP() & ~3U) - 8;
+    for (uint32_t *p = heap_end(); p < sp; p++) *p = MEM_PAINT;
+}
+
+static bool guard_hit;
+
+bool mem_check(void) {
+    const volatile uint32_t *guard = stack_limit();
+    if (guard_hit) return false;
+    for (uint8_t i = 0; i < MEM_GUARD / 4U; i++) {
+        if (guard[i] != MEM_PAINT) {
+            guard_hit = true;
+            trace(TRACE_STACK, 0, (uint16_t)(uint32_t)&guard[i]);
+            LOG("mem: stack reached the guard at %x", (uint32_t)&guard[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+void mem_info(mem_info_t *m) {
+    const uint32_t *p = heap_end();
+    while (p < &_estack && *p == MEM_PAINT) p++;
+
+    m->data = (uint16_t)((uint32_t)&_edata - (uint32_t)&_sdata);
+    m->ramfunc = (uint16_t)((uint32_t)&_eramfunc - (uint32_t)&_sramfunc);
+    m->bss = (uint16_t)((uint32_t)&_ebss - (uint32_t)&_sbss);
+    m->noinit = (uint16_t)((uint32_t)&_enoinit - (uint32_t)&_snoinit);
+    m->heap = (uint16_t)sbrk_used();
+    m->heap_max = (uint16_t)((uint32_t)stack_limit() - (uint32_t)&_end);
+    m->stack_peak = (uint16_t)((uint32_t)&_estack - (uint32_t)p);
+    m->stack_size = (uint16_t)(uint32_t)&_Min_Stack_Size;
+    m->free = (uint16_t)((uint32_t)p - (uint32_t)heap_end());
+    m->guard_ok = mem_check();
+}
@@ -0,0 +1,118 @@
+/* Morse code table, packed text and CW timeline encoder */
+
+#include "morse.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+/* ASCII 0x20..0x5F, packed as in morse_code() */
+static const uint8_t morse_table[64] = {
+    0x00, 0x6B, 0x52, 0x00,   /* sp ! " # */
+    0x89, 0x00, 0x28, 0x5E,   /* $ % & ' */
+    0x36, 0x6D, 0x00, 0x2A,   /* ( ) * + */
+    0x73, 0x61, 0x55, 0x32,   /* , - . / */
+    0x3F, 0x2F, 0x27, 0x23,   /* 0 1 2 3 */
+    0x21, 0x20, 0x30, 0x38,   /* 4 5 6 7 */
+    0x3C, 0x3E, 0x78, 0x6A,   /* 8 9 : ; */
+    0x00, 0x31, 0x00, 0x4C,   /* < = > ? */
+    0x5A, 0x05, 0x18, 0x1A,   /* @ A B C */
+    0x0C, 0x02, 0x12, 0x0E,   /* D E F G */
+    0x10, 0x04, 0x17, 0x0D,   /* H I J K */
+    0x14, 0x07, 0x06, 0x0F,   /* L M N O */
+    0x16, 0x1D, 0x0A, 0x08,   /* P Q R S */
+    0x03, 0x09, 0x11, 0x0B,   /* T U V W */
+    0x19, 0x1B, 0x1C, 0x00,   /* X Y Z [ */
+    0x00, 0x00, 0x00, 0x4D,   /* bs ] ^ _ */
+};
+
+uint8_t morse_code(char c) {
+    if (c >= 'a' && c <= 'z') c -= 32;
+    if (c < 0x20 || c > 0x5F) return 0;
+    return morse_table[c - 0x20];
+}
+
+char morse_char(uint8_t code) {
+    for (uint8_t i = 1; i < sizeof(morse_table); i++) {
+        if (morse_table[i] == code) return (char)(0x20 + i);
+    }
+    return 0;
+}
+
+bool morse_accept(char c, bool *prosign) {
+    bool open = *prosign;
+
+    if (c == '<' || c == '>') {
+        *prosign = (c == '<');
+        return open != *prosign;
+    }
+    if (c == ' ') return !open;
+    return morse_code(c) != 0;
+}
+
+void morse_pack(uint8_t *packed, uint8_t i, char c) {
+    if (c >= 'a' && c <= 'z') c -= 32;
+    uint16_t bit = (uint16_t)i * 6U;
+    uint8_t *p = &packed[bit / 8U];
+    uint16_t w = (uint16_t)((c - 0x20) & 0x3F) << (10U - bit % 8U);
+    uint16_t m = (uint16_t)0x3FU << (10U - bit % 8U);
+
+    p[0] = (uint8_t)((p[0] & ~(m >> 8)) | (w >> 8));
+    if (m & 0xFFU) p[1] = (uint8_t)((p[1] & ~m) | w);
+}
+
+char morse_unpack(const uint8_t *packed, uint8_t i) {
+    uint16_t bit = (uint16_t)i * 6U;
+    const uint8_t *p = &packed[bit / 8U];
+    uint16_t w = (uint16_t)p[0] << 8;
+
+    if (bit % 8U > 2U) w |= p[1];
+    return (char)(0x20 + ((w >> (10U - bit % 8U)) & 0x3FU));
+}
+
+void morse_stream_init(morse_stream_t *s, const uint8_t *packed, uint8_t len) {
+    s->packed = packed;
+    s->len = len;
+    s->pos = 0;
+    s->code = 0;
+    s->prosign = false;
+}
+
+/* Gaps as fixed in v1.5.1: a character gap after each character, a word gap
+   when a space follows (one space; more add MORSE_SPACE each), element gaps
+   only inside a prosign */
+uint8_t morse_stream_next(morse_stream_t *s) {
+    while (s->code < 2U) {
+        if (s->pos >= s->len) return 0;
+        char c = morse_unpack(s->packed, s->pos++);
+        if (c == '<') s->prosign = true;
+        else if (c == '>') s->prosign = false;
+        else if (c == ' ') return MORSE_SPACE;
+        else s->code = morse_code(c);
+    }
+
+    /* Take the first element; it becomes the new leading 1 */
+    uint8_t top = 7;
+    while (!(s->code & (1U << top))) top--;
+    top--;
+    uint8_t on = (s->code & (1U << top)) ? MORSE_DAH_UNITS : MORSE_DIT_UNITS;
+    s->code = (uint8_t)((s->code & ((1U << top) - 1U)) | (1U << top));
+    if (s->code > 1U) return (uint8_t)((on << 4) | MORSE_ELEMENT_GAP);
+
+    /* Last element of the character: the gap depends on what follows */
+    uint8_t gap = s->prosign ? MORSE_ELEMENT_GAP : MORSE_CHAR_GAP;
+    for (; s->pos < s->len; s->pos++) {
+        char c = morse_unpack(s->packed, s->pos);
+        if (c == '<' && !s->prosign) {
+            s->prosign = true;
+        } else if (c == '>' && s->prosign) {
+            s->prosign = false;
+            if (gap == MORSE_ELEMENT_GAP) gap = MORSE_CHAR_GAP;
+        } else if (c == ' ' && gap == MORSE_CHAR_GAP && !s->prosign) {
+            s->pos++;
+            gap = MORSE_WORD_GAP;
+            break;
+        } else {
+            break;
+        }
+    }
+    return (uint8_t)((on << 4) | gap);
+}
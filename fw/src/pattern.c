@@ -0,0 +1,826 @@
+/* LED pattern engine: non-blocking bytecode interpreter for the auto-blink modes */
+
+#include "pattern.h"
+#include "bcm.h"
+#include "morse.h"
+#include "storage.h"
+#include "led.h"
+#include "timer.h"
+#include "trace.h"
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PATTERN_LEDS            5
+#define PATTERN_ALL             0x1FU
+#define PATTERN_LOOP_DEPTH      3
+#define PATTERN_MAX_STEPS       64      /* Instructions per tick without a wait */
+#define PATTERN_MAX_LAG_US      2000U   /* Resync instead of catching up when later than this */
+
+/* User slots in the storage free area (0x63..0xEC), see EEPROM_STRUCTURE.md */
+#define PATTERN_USER_BASE       0x63U
+#define PATTERN_USER_HDR        3U      /* Length, CRC-16 little-endian */
+#define PATTERN_USER_SIZE       (PATTERN_USER_HDR + PATTERN_USER_MAX)
+#define PATTERN_WINDOW          8U      /* User code bytes fetched per storage read */
+#define PATTERN_USER_CW         0x80U   /* Slot header tag of a CW message */
+
+/* CW message 0: { 0x80 | length, packed text }, see EEPROM_STRUCTURE.md */
+#define CW_SLOT                 0x4EU
+#define CW_SLOT_SIZE            21U
+#define CW_STORE_CHARS          8U      /* Characters packed per storage write */
+
+#define CW_WPM_DEFAULT          12U     /* 100 ms unit */
+#define CW_END_UNITS            9U      /* Pause after the message, on top of its last gap */
+#define CW_DIT_MASK             0x11U   /* LED1 + LED5 */
+#define CW_DAH_MASK             0x0EU   /* LED2 + LED3 + LED4 */
+
+/* Built-in modes */
+static const uint8_t pat_off[] = {
+    P_HALT,
+};
+
+static const uint8_t pat_blink[] = {
+    P_PICK, P_SHOW, P_WAIT_RAND(10, 80, 10),
+    P_MASK(0), P_WAIT_RAND(50, 1050, 25),
+    P_END,
+};
+
+static const uint8_t pat_fade[] = {
+    P_PICK, P_LEVEL(255), P_SHOW, P_WAIT(100),
+    P_RAMP(0, 20, 15),
+    P_MASK(0), P_LEVEL(255), P_WAIT_RAND(200, 1200, 25),
+    P_END,
+};
+
+static const uint8_t pat_cw[] = {
+    P_CW,
+    P_END,
+};
+
+static const uint8_t pat_strobo[] = {
+    P_PICK_SET(2, 4),
+    P_LOOP_RAND(3, 6),
+        P_SHOW, P_WAIT_RAND(30, 70, 10),
+        P_MASK(0), P_WAIT_RAND(40, 90, 10),
+    P_NEXT,
+    P_WAIT_RAND(100, 300, 25),
+    P_END,
+};
+
+/* Ten rounds each way, accelerating from 100 ms to 25 ms per step, with an
+   occasional double blink; all LEDs flash when the direction changes */
+static const uint8_t pat_icircle[] = {
+    P_SET_VAR(100),
+    P_LOOP(50),
+        P_MAYBE(224,
+            P_PICK,
+            P_LOOP(2), P_SHOW, P_WAIT(50), P_MASK(0), P_WAIT(30), P_NEXT),
+        P_ADD_VAR(-3, 25), P_CURSOR, P_SHOW, P_WAIT_VAR, P_STEP,
+    P_NEXT,
+    P_MASK(PATTERN_ALL), P_WAIT(80), P_MASK(0), P_WAIT(200),
+    P_REVERSE,
+    P_END,
+};
+
+/* One of four effects per round, picked at random; each hands the LEDs
+   straight over to the next */
+static const uint8_t pat_disco[] = {
+    P_MAYBE(192,        /* Chase forwards and back */
+        P_MASK(0x01), P_WAIT(80), P_MASK(0x02), P_WAIT(80), P_MASK(0x04), P_WAIT(80),
+        P_MASK(0x08), P_WAIT(80), P_MASK(0x10), P_WAIT(160), P_MASK(0x08), P_WAIT(80),
+        P_MASK(0x04), P_WAIT(80), P_MASK(0x02), P_WAIT(80), P_MASK(0x01), P_WAIT(80),
+        P_END),
+    P_MAYBE(171,        /* Random bursts */
+        P_LOOP_RAND(2, 5), P_PICK_SET(1, 5), P_SHOW, P_WAIT_RAND(25, 150, 25), P_NEXT,
+        P_END),
+    P_MAYBE(128,        /* All pulsing together */
+        P_LOOP(3), P_MASK(PATTERN_ALL), P_WAIT(150), P_MASK(0), P_WAIT(75), P_NEXT,
+        P_END),
+    P_LOOP(6),          /* Alternating pairs */
+        P_MASK(0x05), P_WAIT(60), P_MASK(0x0A), P_WAIT(60), P_MASK(0x10), P_WAIT(40),
+    P_NEXT,
+    P_END,
+};
+
+#define PATTERN(name, code)     { name, code, sizeof(code) }
+
+static const struct {
+    const char *name;
+    const uint8_t *code;
+    uint8_t len;
+} patterns[] = {
+    PATTERN("OFF",     pat_off),
+    PATTERN("BLINK",   pat_blink),
+    PATTERN("FADE",    pat_fade),
+    PATTERN("CW",      pat_cw),
+    PATTERN("STROBO",  pat_strobo),
+    PATTERN("ICIRCLE", pat_icircle),
+    PATTERN("DISCO",   pat_disco),
+};
+#define PATTERN_BUILTINS    (sizeof(patterns) / sizeof(patterns[0]))
+#define PATTERN_COUNT       (PATTERN_BUILTINS + PATTERN_USER_SLOTS)
+
+static const char *const user_names[PATTERN_USER_SLOTS] = { "USER1", "USER2" };
+
+static struct {
+    const uint8_t *code;    /* NULL for a user slot, read through win */
+    uint16_t base;          /* Storage address of user code */
+    uint8_t len;
+    uint8_t mode;
+    uint8_t pc;
+    uint8_t sub;            /* Progress inside RAMP */
+    bool halted;
+    uint32_t wake;          /* Deadline of the current wait */
+    uint8_t mask;
+    uint8_t sel;
+    uint8_t level;
+    uint8_t ramp_from;
+    uint8_t cursor;
+    int8_t dir;
+    int8_t last_pick;
+    uint16_t var;
+    uint8_t depth;
+    struct {
+        uint8_t pc;
+        uint8_t left;
+    } loop[PATTERN_LOOP_DEPTH];
+} vm = { .mode = 0xFF, .last_pick = -1 };
+
+/* Stored CW messages (length in characters, 0 = empty) and the selected one,
+   packed as in storage. PAT_OP_CW hands it to the CW timer, whose interrupt
+   encodes and writes every edge (pattern_cw_next). */
+static uint8_t cw_msg_len[PATTERN_CW_MSGS];
+static uint8_t cw_sel;
+static uint8_t cw_packed[MORSE_PACKED_BYTES(PATTERN_CW_MSG_MAX)];
+static uint8_t cw_len;
+
+static struct {
+    morse_stream_t enc;
+    volatile uint8_t ev;    /* Event being sent, 0 when done */
+    volatile bool gap;      /* On part sent, off part pending */
+    bool playing;
+    uint16_t unit_ms;       /* Dit length at the character speed */
+    uint16_t space_ms;      /* Unit of character and word gaps (Farnsworth) */
+} cw = { .unit_ms = 1200U / CW_WPM_DEFAULT, .space_ms = 1200U / CW_WPM_DEFAULT };
+
+/* Read-ahead window over the running user pattern */
+static struct {
+    uint8_t at;
+    uint8_t n;
+    uint8_t buf[PATTERN_WINDOW];
+} win;
+
+/* Loaded user slots (len 0 = empty) and the upload in progress */
+static struct {
+    uint8_t len;
+    uint16_t crc;
+} user[PATTERN_USER_SLOTS];
+
+static struct {
+    bool active;
+    uint8_t slot;
+    uint8_t len;
+    uint16_t crc;
+} load;
+
+/* Streamed message store in progress */
+static struct {
+    bool active;
+    bool prosign;
+    bool spilled;           /* Message 1 has claimed slot 2 */
+    uint8_t msg;
+    uint8_t len;
+    uint16_t crc;
+    uint8_t buf[MORSE_PACKED_BYTES(CW_STORE_CHARS)];
+} store;
+
+static uint32_t lcg_state = 0xA5A5A5A5UL;
+
+static uint32_t lcg_rand(void) {
+    lcg_state = lcg_state * 1664525UL + 1013904223UL;
+    return lcg_state;
+}
+
+static uint32_t rand_below(uint32_t n) {
+    /* High bits of an LCG are the random ones; n is 0 only for bad operands
+       in uploaded code */
+    return n ? (lcg_rand() >> 16) % n : 0;
+}
+
+static bool due(uint32_t t, uint32_t now) {
+    return (int32_t)(now - t) >= 0;
+}
+
+/* Drive the LEDs in mask at the current level, dimmed by the BCM driver */
+static void output(void) {
+    uint8_t levels[PATTERN_LEDS];
+    for (uint8_t i = 0; i < PATTERN_LEDS; i++) {
+        levels[i] = (vm.mask & (1U << i)) ? vm.level : 0;
+    }
+    BCM_SetLevels(levels);
+}
+
+static uint16_t user_addr(uint8_t slot) {
+    return (uint16_t)(PATTERN_USER_BASE + slot * PATTERN_USER_SIZE);
+}
+
+static uint16_t crc16_update(uint16_t crc, uint8_t b) {
+    crc ^= (uint16_t)b << 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        crc = (crc & 0x8000U) ? (uint16_t)((crc << 1) ^ 0x1021U) : (uint16_t)(crc << 1);
+    }
+    return crc;
+}
+
+/* Off time of an event: element gaps at the character speed, the longer
+   gaps in Farnsworth units */
+static uint32_t cw_off_ms(uint8_t ev) {
+    uint8_t units = MORSE_OFF_UNITS(ev);
+    return units * (uint32_t)(units == MORSE_ELEMENT_GAP ? cw.unit_ms : cw.space_ms);
+}
+
+/* CW timer interrupt: write the next edge, return the time to the one after
+   it (0 when the message is done). Pauses with no element merge into one
+   wait, up to the 16-bit limit of the timer. */
+uint16_t pattern_cw_next(void) {
+    uint8_t ev = cw.ev;
+    if (!ev) return 0;
+    uint8_t on = MORSE_ON_UNITS(ev);
+    if (!cw.gap && on) {
+        cw.gap = true;
+        led_write_mask(on == MORSE_DAH_UNITS ? CW_DAH_MASK : CW_DIT_MASK);
+        return (uint16_t)(on * cw.unit_ms);
+    }
+    led_write_mask(0);
+    uint32_t off = 0;
+    do {
+        off += cw_off_ms(ev);
+        ev = morse_stream_next(&cw.enc);
+    } while (ev && !MORSE_ON_UNITS(ev) && off + cw_off_ms(ev) <= 0xFFFFU);
+    cw.ev = ev;
+    cw.gap = false;
+    return ev ? (uint16_t)off : 0;
+}
+
+/* Start sending the selected message; returns the whole duration in ms,
+   including the CW_END_UNITS pause, for the interpreter to wait */
+static uint32_t cw_start(void) {
+    uint32_t total = CW_END_UNITS * (uint32_t)cw.space_ms;
+    uint8_t ev;
+
+    morse_stream_init(&cw.enc, cw_packed, cw_len);
+    while ((ev = morse_stream_next(&cw.enc)) != 0) {
+        total += MORSE_ON_UNITS(ev) * (uint32_t)cw.unit_ms + cw_off_ms(ev);
+    }
+    if (cw_len) {
+        morse_stream_init(&cw.enc, cw_packed, cw_len);
+        cw.ev = morse_stream_next(&cw.enc);
+        cw.gap = false;
+        cw.playing = true;
+        CW_TimerStart(pattern_cw_next());
+    }
+    return total;
+}
+
+/* Stop the CW timer, possibly in the middle of an element */
+static void cw_stop(void) {
+    if (!cw.playing) return;
+    CW_TimerStop();
+    cw.playing = false;
+    led_write_mask(0);
+}
+
+static void vm_restart(uint8_t mode, uint32_t now) {
+    cw_stop();
+    vm.mode = mode;
+    if (mode < PATTERN_BUILTINS) {
+        vm.code = patterns[mode].code;
+        vm.len = patterns[mode].len;
+    } else {
+        /* An empty slot halts at once, like OFF */
+        vm.code = NULL;
+        vm.base = user_addr(mode - PATTERN_BUILTINS) + PATTERN_USER_HDR;
+        vm.len = user[mode - PATTERN_BUILTINS].len;
+        win.n = 0;
+    }
+    vm.pc = 0;
+    vm.sub = 0;
+    vm.depth = 0;
+    vm.halted = false;
+    vm.wake = now;
+    vm.mask = 0;
+    vm.level = 255;
+    vm.cursor = 0;
+    vm.dir = 1;
+    output();
+}
+
+/* Code byte at offset at; running off the end halts */
+static uint8_t code_at(uint8_t at) {
+    if (at >= vm.len) return PAT_OP_HALT;
+    if (vm.code) return vm.code[at];
+    if (at < win.at || at >= win.at + win.n) {
+        uint8_t n = (uint8_t)(vm.len - at);
+        if (n > PATTERN_WINDOW) n = PATTERN_WINDOW;
+        if (storage_read(vm.base + at, win.buf, n) != 0) {
+            win.n = 0;
+            return PAT_OP_HALT;
+        }
+        win.at = at;
+        win.n = n;
+    }
+    return win.buf[at - win.at];
+}
+
+static uint8_t arg(uint8_t k) {
+    return code_at((uint8_t)(vm.pc + k));
+}
+
+static uint16_t operand16(uint8_t k) {
+    return (uint16_t)(arg(k) | ((uint16_t)arg(k + 1) << 8));
+}
+
+/* Execute instructions at time vm.wake until the next wait */
+static void vm_run(void) {
+    uint32_t t = vm.wake;
+
+    for (uint8_t steps = 0; steps < PATTERN_MAX_STEPS; steps++) {
+        uint8_t op = code_at(vm.pc);
+        uint32_t wait_ms = 0;
+
+        switch (op) {
+            case PAT_OP_END:
+                vm.pc = 0;
+                vm.depth = 0;
+                break;
+            case PAT_OP_HALT:
+                vm.halted = true;
+                return;
+            case PAT_OP_MASK:
+                vm.mask = arg(1) & PATTERN_ALL;
+                output();
+                vm.pc += 2;
+                break;
+            case PAT_OP_SHOW:
+                vm.mask = vm.sel;
+                output();
+                vm.pc += 1;
+                break;
+            case PAT_OP_LEVEL:
+                vm.level = arg(1);
+                output();
+                vm.pc += 2;
+                break;
+            case PAT_OP_RAMP: {
+                uint8_t target = arg(1), n = arg(2);
+                if (vm.sub >= n) {
+                    vm.level = target;
+                    output();
+                    vm.sub = 0;
+                    vm.pc += 4;
+                    break;
+                }
+                if (vm.sub == 0) vm.ramp_from = vm.level;
+                int32_t d = (int32_t)target - vm.ramp_from;
+                int32_t half = (d >= 0) ? n / 2 : -(n / 2);
+                vm.level = (uint8_t)(vm.ramp_from + (d * vm.sub + half) / n);
+                output();
+                vm.sub++;
+                wait_ms = arg(3);
+                break;
+            }
+            case PAT_OP_WAIT:
+                wait_ms = operand16(1);
+                vm.pc += 3;
+                break;
+            case PAT_OP_WAIT_RAND: {
+                uint16_t lo = operand16(1), hi = operand16(3);
+                uint8_t step = arg(5) ? arg(5) : 1;
+                wait_ms = lo + step * rand_below((uint32_t)(hi - lo) / step + 1U);
+                vm.pc += 6;
+                break;
+            }
+            case PAT_OP_WAIT_VAR:
+                wait_ms = vm.var;
+                vm.pc += 1;
+                break;
+            case PAT_OP_SET_VAR:
+                vm.var = operand16(1);
+                vm.pc += 3;
+                break;
+            case PAT_OP_ADD_VAR: {
+                int32_t v = (int32_t)vm.var + (int8_t)arg(1);
+                int32_t lim = operand16(2);
+                if ((int8_t)arg(1) < 0 ? v < lim : v > lim) v = lim;
+                vm.var = (uint16_t)v;
+                vm.pc += 4;
+                break;
+            }
+            case PAT_OP_LOOP:
+            case PAT_OP_LOOP_RAND: {
+                uint8_t n = arg(1);
+                uint8_t len = (op == PAT_OP_LOOP) ? 2 : 3;
+                if (op == PAT_OP_LOOP_RAND) n += (uint8_t)rand_below((uint32_t)(arg(2) - n) + 1U);
+                if (vm.depth < PATTERN_LOOP_DEPTH) {
+                    vm.loop[vm.depth].pc = (uint8_t)(vm.pc + len);
+                    vm.loop[vm.depth].left = n;
+                    vm.depth++;
+                }
+                vm.pc += len;
+                break;
+            }
+            case PAT_OP_NEXT:
+                if (vm.depth && --vm.loop[vm.depth - 1].left) {
+                    vm.pc = vm.loop[vm.depth - 1].pc;
+                } else {
+                    if (vm.depth) vm.depth--;
+                    vm.pc += 1;
+                }
+                break;
+            case PAT_OP_PICK: {
+                int8_t idx = (int8_t)rand_below(PATTERN_LEDS);
+                if (idx == vm.last_pick) idx = (int8_t)((idx + 1) % PATTERN_LEDS);
+                vm.last_pick = idx;
+                vm.sel = (uint8_t)(1U << idx);
+                vm.pc += 1;
+                break;
+            }
+            case PAT_OP_PICK_SET: {
+                uint8_t lo = arg(1), hi = arg(2);
+                uint8_t n = lo + (uint8_t)rand_below((uint32_t)(hi - lo) + 1U), count = 0;
+                if (n > PATTERN_LEDS) n = PATTERN_LEDS;
+                vm.sel = 0;
+                while (count < n) {
+                    uint8_t bit = (uint8_t)(1U << rand_below(PATTERN_LEDS));
+                    if (vm.sel & bit) continue;
+                    vm.sel |= bit;
+                    count++;
+                }
+                vm.pc += 3;
+                break;
+            }
+            case PAT_OP_CURSOR:
+                vm.sel = (uint8_t)(1U << vm.cursor);
+                vm.pc += 1;
+                break;
+            case PAT_OP_STEP:
+                vm.cursor = (uint8_t)((vm.cursor + PATTERN_LEDS + vm.dir) % PATTERN_LEDS);
+                vm.pc += 1;
+                break;
+            case PAT_OP_REVERSE:
+                vm.dir = (int8_t)-vm.dir;
+                vm.pc += 1;
+                break;
+            case PAT_OP_CHANCE:
+                if (rand_below(256) < arg(1)) vm.pc += arg(2);
+                vm.pc += 3;
+                break;
+            case PAT_OP_CW:
+                cw_stop();
+                vm.mask = 0;
+                output();
+                wait_ms = cw_start();
+                vm.pc += 1;
+                break;
+            default:
+                /* Unknown opcode: stop rather than run off the table */
+                vm.halted = true;
+                return;
+        }
+        if (wait_ms) {
+            vm.wake = t + wait_ms * 1000U;
+            /* Fetch the code due at the deadline now, so storage reads (5 ms
+               for a window on the 24C02) fall into the wait; END is taken early */
+            if (!vm.code && code_at(vm.pc) == PAT_OP_END) {
+                vm.pc = 0;
+                vm.depth = 0;
+                code_at(0);
+            }
+            return;
+        }
+    }
+    /* No wait in a full batch: yield, continue on the next tick */
+}
+
+static uint16_t cw_addr(uint8_t msg) {
+    return msg ? (uint16_t)(user_addr(msg - 1U) + PATTERN_USER_HDR) : (uint16_t)(CW_SLOT + 1U);
+}
+
+/* Message 1 is longer than its slot and runs on into slot 2 */
+static bool cw_spills(void) {
+    return MORSE_PACKED_BYTES(cw_msg_len[1]) > PATTERN_USER_MAX;
+}
+
+uint8_t pattern_cw_capacity(uint8_t msg) {
+    static const uint8_t bytes[PATTERN_CW_MSGS] = {
+        CW_SLOT_SIZE - 1U, 2U * PATTERN_USER_SIZE - PATTERN_USER_HDR, PATTERN_USER_MAX,
+    };
+    return (msg < PATTERN_CW_MSGS) ? (uint8_t)(bytes[msg] * 8U / 6U) : 0;
+}
+
+uint8_t pattern_cw_length(uint8_t msg) {
+    return (msg < PATTERN_CW_MSGS) ? cw_msg_len[msg] : 0;
+}
+
+uint8_t pattern_cw_selected(void) {
+    return cw_sel;
+}
+
+int pattern_cw_select(uint8_t msg) {
+    if (msg >= PATTERN_CW_MSGS) return -1;
+    cw_stop();
+    cw_sel = msg;
+    cw_len = cw_msg_len[msg];
+    if (cw_len && storage_read(cw_addr(msg), cw_packed, MORSE_PACKED_BYTES(cw_len)) != 0) cw_len = 0;
+    return cw_len ? 0 : -1;
+}
+
+/* A message was emptied or rewritten: reload it if it is the one sent */
+static void cw_changed(uint8_t msg) {
+    if (msg == cw_sel) pattern_cw_select(msg);
+}
+
+uint8_t pattern_cw_read(uint8_t msg, uint8_t at, char *out) {
+    uint8_t buf[MORSE_PACKED_BYTES(CW_STORE_CHARS)];
+    uint8_t n = 0;
+
+    if (msg >= PATTERN_CW_MSGS || at % CW_STORE_CHARS || at >= cw_msg_len[msg]) return 0;
+    n = (uint8_t)(cw_msg_len[msg] - at);
+    if (n > CW_STORE_CHARS) n = CW_STORE_CHARS;
+    if (storage_read(cw_addr(msg) + at / CW_STORE_CHARS * sizeof(buf), buf, MORSE_PACKED_BYTES(n)) != 0) return 0;
+    for (uint8_t i = 0; i < n; i++) out[i] = morse_unpack(buf, i);
+    return n;
+}
+
+void pattern_cw_speed(uint8_t wpm, uint8_t farnsworth_wpm) {
+    uint32_t c = wpm, sp = farnsworth_wpm;
+
+    cw_stop();
+    cw.unit_ms = (uint16_t)((1200U + c / 2U) / c);
+    cw.space_ms = cw.unit_ms;
+    if (sp && sp < c) {
+        /* PARIS: 31 units of characters and 19 of spacing per word. The
+           characters keep speed c, the spacing fills the rest of a word at
+           speed sp (ARRL: ta = (60c - 37.2s) / (sc) seconds). */
+        uint32_t ta_ms = (60000U * c - 37200U * sp) / (sp * c);
+        cw.space_ms = (uint16_t)((ta_ms + 9U) / 19U);
+    }
+}
+
+uint8_t pattern_count(void) {
+    return (uint8_t)PATTERN_COUNT;
+}
+
+bool pattern_is_user(uint8_t mode) {
+    return mode >= PATTERN_BUILTINS && mode < PATTERN_COUNT;
+}
+
+const char *pattern_name(uint8_t mode) {
+    if (mode < PATTERN_BUILTINS) return patterns[mode].name;
+    if (pattern_is_user(mode) && user[mode - PATTERN_BUILTINS].len) return user_names[mode - PATTERN_BUILTINS];
+    return NULL;
+}
+
+/* Restart the interpreter on the next tick if it runs the given slot */
+static void user_changed(uint8_t slot) {
+    if (vm.mode == PATTERN_BUILTINS + slot) vm.mode = 0xFF;
+}
+
+/* Empty a user slot for new contents, dropping whatever it held: a pattern,
+   a message, or the tail of message 1 (which then goes as a whole) */
+static int slot_release(uint8_t slot) {
+    static const uint8_t empty = 0;
+    bool spill = cw_spills();
+    int rc = storage_update(user_addr(slot), &empty, 1, NULL);
+
+    user[slot].len = 0;
+    user_changed(slot);
+    if (spill && storage_update(user_addr(1U - slot), &empty, 1, NULL) != 0) rc = -1;
+    if (spill || cw_msg_len[slot + 1U]) {
+        if (spill) cw_msg_len[1] = 0;
+        cw_msg_len[slot + 1U] = 0;
+        cw_changed(1);
+        cw_changed(2);
+    }
+    return rc;
+}
+
+/* CRC-16 of n bytes in storage; a read error gives a value that cannot match
+   the stored one */
+static uint16_t storage_crc(uint16_t addr, uint8_t n, uint16_t stored) {
+    uint8_t buf[PATTERN_WINDOW];
+    uint16_t crc = 0xFFFFU;
+
+    for (uint8_t at = 0; at < n; at += PATTERN_WINDOW) {
+        uint8_t k = (uint8_t)(n - at);
+        if (k > PATTERN_WINDOW) k = PATTERN_WINDOW;
+        if (storage_read(addr + at, buf, k) != 0) return (uint16_t)~stored;
+        for (uint8_t i = 0; i < k; i++) crc = crc16_update(crc, buf[i]);
+    }
+    return crc;
+}
+
+/* Message 0 as plain text (older firmware) is packed in place */
+static void cw_migrate(void) {
+    char text[CW_SLOT_SIZE];
+
+    if (storage_read(CW_SLOT, (uint8_t *)text, sizeof(text)) != 0) return;
+    text[CW_SLOT_SIZE - 1U] = '\0';
+    if (pattern_cw_begin(0) == 0 && pattern_cw_text(text) == 0) pattern_cw_end();
+}
+
+void pattern_init(void) {
+    uint8_t hdr[PATTERN_USER_HDR];
+
+    cw_msg_len[0] = 0;
+    if (storage_read(CW_SLOT, hdr, 1) == 0) {
+        if (hdr[0] & PATTERN_USER_CW) {
+            uint8_t n = hdr[0] & 0x7FU;
+            if (n <= pattern_cw_capacity(0)) cw_msg_len[0] = n;
+        } else if (hdr[0]) {
+            cw_migrate();
+        }
+    }
+
+    for (uint8_t slot = 0; slot < PATTERN_USER_SLOTS; slot++) {
+        uint16_t addr = user_addr(slot);
+
+        user[slot].len = 0;
+        cw_msg_len[slot + 1U] = 0;
+        user_changed(slot);
+        if (slot == 1 && cw_spills()) continue;     /* Tail of message 1 */
+        if (storage_read(addr, hdr, sizeof(hdr)) != 0) continue;
+        if (hdr[0] == PATTERN_USER_CW) {
+            uint8_t n = hdr[1];
+            if (n == 0 || n > pattern_cw_capacity(slot + 1U)) continue;
+            uint16_t crc = storage_crc(addr + PATTERN_USER_HDR, MORSE_PACKED_BYTES(n), hdr[2]);
+            if ((crc & 0xFFU) == hdr[2]) cw_msg_len[slot + 1U] = n;
+            continue;
+        }
+        if (hdr[0] == 0 || hdr[0] > PATTERN_USER_MAX) continue;
+        uint16_t stored = (uint16_t)(hdr[1] | ((uint16_t)hdr[2] << 8));
+        uint16_t crc = storage_crc(addr + PATTERN_USER_HDR, hdr[0], stored);
+        if (crc != stored) continue;
+        user[slot].len = hdr[0];
+        user[slot].crc = crc;
+    }
+    pattern_cw_select(cw_sel);
+}
+
+int pattern_user_cw(uint8_t mode) {
+    if (!pattern_is_user(mode)) return -1;
+    uint8_t slot = (uint8_t)(mode - PATTERN_BUILTINS);
+    if (slot == 1 && cw_spills()) return 1;
+    return cw_msg_len[slot + 1U] ? slot + 1 : -1;
+}
+
+int pattern_cw_delete(uint8_t msg) {
+    if (msg == 0 || msg >= PATTERN_CW_MSGS || !cw_msg_len[msg]) return -1;
+    return slot_release(msg - 1U);
+}
+
+int pattern_cw_begin(uint8_t msg) {
+    static const uint8_t empty = 0;
+
+    store.active = false;
+    if (msg >= PATTERN_CW_MSGS) return -1;
+    if (msg == 0) {
+        cw_msg_len[0] = 0;
+        cw_changed(0);
+        if (storage_update(CW_SLOT, &empty, 1, NULL) != 0) return -1;
+    } else if (slot_release(msg - 1U) != 0) {
+        return -1;
+    }
+    store.active = true;
+    store.prosign = false;
+    store.spilled = false;
+    store.msg = msg;
+    store.len = 0;
+    store.crc = 0xFFFFU;
+    return 0;
+}
+
+/* Write the packed group in store.buf holding the last n characters */
+static int store_flush(uint8_t n) {
+    uint8_t at = (uint8_t)((store.len - n) / CW_STORE_CHARS * sizeof(store.buf));
+    uint8_t bytes = MORSE_PACKED_BYTES(n);
+
+    /* Message 1 crossing into slot 2 takes it over */
+    if (store.msg == 1 && !store.spilled && at + bytes > PATTERN_USER_MAX) {
+        if (slot_release(1) != 0) return -1;
+        store.spilled = true;
+    }
+    if (storage_update(cw_addr(store.msg) + at, store.buf, bytes, NULL) != 0) return -1;
+    for (uint8_t i = 0; i < bytes; i++) store.crc = crc16_update(store.crc, store.buf[i]);
+    return 0;
+}
+
+int pattern_cw_text(const char *text) {
+    if (!store.active) return -1;
+    for (; *text; text++) {
+        if (store.len >= pattern_cw_capacity(store.msg) || !morse_accept(*text, &store.prosign)) {
+            store.active = false;
+            return -1;
+        }
+        morse_pack(store.buf, store.len % CW_STORE_CHARS, *text);
+        store.len++;
+        if (store.len % CW_STORE_CHARS == 0 && store_flush(CW_STORE_CHARS) != 0) {
+            store.active = false;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int pattern_cw_end(void) {
+    uint8_t rest = store.len % CW_STORE_CHARS;
+
+    if (!store.active) return -1;
+    store.active = false;
+    if (store.len == 0 || store.prosign) return -1;
+    if (rest) {
+        /* Zero the unused bits of the last byte */
+        for (uint8_t i = rest; i < CW_STORE_CHARS; i++) morse_pack(store.buf, i, ' ');
+        if (store_flush(rest) != 0) return -1;
+    }
+
+    /* Header last: a message only becomes valid once all of its text is stored */
+    if (store.msg == 0) {
+        uint8_t hdr = (uint8_t)(PATTERN_USER_CW | store.len);
+        if (storage_update(CW_SLOT, &hdr, 1, NULL) != 0) return -1;
+    } else {
+        uint8_t hdr[PATTERN_USER_HDR] = { PATTERN_USER_CW, store.len, (uint8_t)(store.crc & 0xFFU) };
+        if (storage_update(user_addr(store.msg - 1U), hdr, sizeof(hdr), NULL) != 0) return -1;
+    }
+    cw_msg_len[store.msg] = store.len;
+    cw_changed(store.msg);
+    return 0;
+}
+
+int pattern_user_info(uint8_t mode, uint8_t *len, uint16_t *crc) {
+    if (!pattern_is_user(mode) || user[mode - PATTERN_BUILTINS].len == 0) return -1;
+    *len = user[mode - PATTERN_BUILTINS].len;
+    *crc = user[mode - PATTERN_BUILTINS].crc;
+    return 0;
+}
+
+int pattern_delete(uint8_t mode) {
+    if (!pattern_is_user(mode)) return -1;
+    return slot_release((uint8_t)(mode - PATTERN_BUILTINS));
+}
+
+int pattern_load_begin(uint8_t mode) {
+    load.active = false;
+    if (pattern_delete(mode) != 0) return -1;
+    load.active = true;
+    load.slot = (uint8_t)(mode - PATTERN_BUILTINS);
+    load.len = 0;
+    load.crc = 0xFFFFU;
+    return 0;
+}
+
+int pattern_load_data(const uint8_t *data, uint8_t len) {
+    if (!load.active) return -1;
+    if (len > PATTERN_USER_MAX - load.len ||
+        storage_update(user_addr(load.slot) + PATTERN_USER_HDR + load.len, data, len, NULL) != 0) {
+        load.active = false;
+        return -1;
+    }
+    for (uint8_t i = 0; i < len; i++) load.crc = crc16_update(load.crc, data[i]);
+    load.len += len;
+    return 0;
+}
+
+int pattern_load_end(uint16_t crc) {
+    if (!load.active) return -1;
+    load.active = false;
+    if (load.len == 0 || crc != load.crc) return -1;
+
+    /* Header last: a slot only becomes valid once all of its code is stored */
+    uint8_t hdr[PATTERN_USER_HDR] = { load.len, (uint8_t)(crc & 0xFFU), (uint8_t)(crc >> 8) };
+    if (storage_update(user_addr(load.slot), hdr, sizeof(hdr), NULL) != 0) return -1;
+    user[load.slot].len = load.len;
+    user[load.slot].crc = crc;
+    user_changed(load.slot);
+    return 0;
+}
+
+uint32_t pattern_tick(uint8_t mode, uint32_t now_us) {
+    if (mode >= PATTERN_COUNT) mode = 0;
+    if (mode != vm.mode) {
+        trace(TRACE_MODE, mode, vm.mode);
+        vm_restart(mode, now_us);
+    }
+
+    /* Running late (e.g. a blocking CLI command): continue from now */
+    if (!vm.halted && (int32_t)(now_us - vm.wake) > (int32_t)PATTERN_MAX_LAG_US) vm.wake = now_us;
+
+    while (!vm.halted && due(vm.wake, now_us)) {
+        uint32_t before = vm.wake;
+        vm_run();
+        if (!vm.halted && vm.wake == before) break;     /* Yielded */
+    }
+
+    uint32_t next = PATTERN_IDLE;
+    if (!vm.halted) next = due(vm.wake, now_us) ? 0 : vm.wake - now_us;
+    return next;
+}
@@ -0,0 +1,91 @@
+/* Power source profiles on BADGE_PWR_SENSE */
+
+#include "power.h"
+#include "irq.h"
+#include "event.h"
+#include "system.h"
+#include "bcm.h"
+#include "led.h"
+#include "gpio.h"
+#include "pins.h"
+#include "log.h"
+#include "trace.h"
+#include <stdbool.h>
+
+static const struct {
+    uint8_t clock;          /* clock_profile_t */
+    uint8_t brightness;     /* BCM scale */
+    uint8_t max_lit;
+    const char *name;
+} profiles[POWER_SOURCES] = {
+    [POWER_BATTERY] = { CLOCK_ECO, POWER_BATTERY_BRIGHTNESS, POWER_BATTERY_MAX_LIT, "battery" },
+    [POWER_BADGE] = { CLOCK_PERF, 255, LED_MAX_LIT_ALL, "badge" },
+};
+
+/* pending and t_us: set by the EXTI interrupt, cleared by the main loop
+   under the mask */
+static struct {
+    uint8_t source;
+    volatile bool pending;
+    volatile uint32_t t_us; /* Last edge */
+    uint16_t switches[POWER_SOURCES];
+} pwr;
+
+static uint8_t sense(void) {
+    return PIN_READ(BADGE_PWR_SENSE) ? POWER_BADGE : POWER_BATTERY;
+}
+
+static void apply(uint8_t source) {
+    pwr.source = source;
+    System_SetClockProfile(profiles[source].clock);
+    BCM_SetScale(profiles[source].brightness);
+    led_set_max_lit(profiles[source].max_lit);
+}
+
+void power_init(void) {
+    apply(sense());
+    GPIO_EnableIRQ(BADGE_PWR_SENSE_GPIO_PORT, BADGE_PWR_SENSE_GPIO_PIN, GPIO_EDGE_BOTH);
+}
+
+void power_edge(uint8_t level, uint32_t t_us) {
+    pwr.t_us = t_us;
+    if (pwr.pending) return;    /* Bounce: the main loop is already told */
+    pwr.pending = true;
+    event_post(EVENT_POWER, level, 0, t_us);
+}
+
+uint32_t power_tick(uint32_t now_us) {
+    uint32_t primask = irq_save();
+    if (!pwr.pending) {
+        irq_restore(primask);
+        return POWER_IDLE;
+    }
+    uint32_t quiet = now_us - pwr.t_us;
+    if (quiet < POWER_SETTLE_US) {
+        irq_restore(primask);
+        return POWER_SETTLE_US - quiet;
+    }
+    pwr.pending = false;
+    irq_restore(primask);
+
+    uint8_t source = sense();
+    if (source != pwr.source) {
+        pwr.switches[source]++;
+        apply(source);
+        trace(TRACE_POWER, source, pwr.switches[source]);
+        LOG("power: source %u (0 battery, 1 badge), switch %u", source, pwr.switches[source]);
+    }
+    return POWER_IDLE;
+}
+
+uint8_t power_source(void) {
+    return pwr.source;
+}
+
+const char *power_source_name(uint8_t source) {
+    return source < POWER_SOURCES ? profiles[source].name : "?";
+}
+
+uint16_t power_switches(uint8_t source) {
+    return source < POWER_SOURCES ? pwr.switches[source] : 0;
+}
@@ -0,0 +1,248 @@
+/* Configuration storage: 24C02 EEPROM or flash-emulated EEPROM
+ *
+ * Flash emulation uses two 2 KB pages in a page-swap scheme. Each page starts
+ * with a header double word { FEE_PAGE_MAGIC, sequence }, followed by 8-byte
+ * records { FEE_REC_TAG | word index, data word }. A later record for the same
+ * word overrides an earlier one. When the active page is full, the live words
+ * are compacted into the other (freshly erased) page and its header is written
+ * last, so an interrupted swap leaves the old page valid. The whole emulated
+ * area is mirrored in a RAM cache, so reads never touch flash.
+ */
+
+#include "storage.h"
+#include "flash.h"
+#include "i2c_eeprom.h"
+#include "config.h"
+#include "trace.h"
+#include "watchdog.h"
+#include "timer.h"
+#include <stddef.h>
+
+#define FEE_SIZE            (EEPROM_SIZE - STORAGE_FLASH_BASE)  /* 204 bytes */
+#define FEE_WORDS           (FEE_SIZE / 4U)
+#define FEE_PAGE_MAGIC      0x31454546UL    /* "FEE1" */
+#define FEE_REC_TAG         0x5EE00000UL
+#define FEE_REC_MASK        0xFFFFFF00UL
+#define FEE_ERASED          0xFFFFFFFFUL
+#define FEE_SLOTS           (FLASH_EMU_PAGE_SIZE / 8U)          /* incl. header */
+
+static Storage_Backend_t backend = STORAGE_NONE;
+static bool eeprom_present = false;
+
+#if STORAGE_BACKEND != STORAGE_BACKEND_EEPROM
+static uint8_t fee_cache[FEE_SIZE];
+static uint8_t fee_active;              /* Index of the active page */
+static uint32_t fee_sequence;           /* Sequence number of the active page */
+static uint16_t fee_next;               /* Next free slot in the active page */
+
+static const uint32_t *fee_page(uint8_t n) {
+    return (const uint32_t *)(_fee_start + (uint32_t)n * FLASH_EMU_PAGE_SIZE);
+}
+
+static uint32_t fee_cache_word(uint8_t idx) {
+    const uint8_t *p = &fee_cache[idx * 4U];
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool fee_page_valid(uint8_t n) {
+    return fee_page(n)[0] == FEE_PAGE_MAGIC;
+}
+
+/* Rebuild the RAM cache from the records of the active page */
+static void fee_replay(void) {
+    const uint32_t *page = fee_page(fee_active);
+
+    fee_next = 1;
+    for (uint16_t slot = 1; slot < FEE_SLOTS; slot++) {
+        uint32_t tag = page[slot * 2U];
+        if (tag == FEE_ERASED) continue;
+        fee_next = slot + 1;
+        uint32_t idx = tag & ~FEE_REC_MASK;
+        if ((tag & FEE_REC_MASK) != FEE_REC_TAG || idx >= FEE_WORDS) continue;
+        uint32_t data = page[slot * 2U + 1U];
+        for (uint8_t b = 0; b < 4; b++) {
+            fee_cache[idx * 4U + b] = (uint8_t)(data >> (b * 8U));
+        }
+    }
+}
+
+/* Erase the inactive page, copy every non-zero cached word into it, word
+   new_idx as new_word, and make it active. Zero words are the blank default
+   and need no record. On failure the old page stays active. */
+static int fee_swap(uint8_t new_idx, uint32_t new_word) {
+    uint8_t target = fee_active ^ 1U;
+    const uint32_t *page = fee_page(target);
+    uint16_t slot = 1;
+
+    if (Flash_ErasePage(page) != 0) return -1;
+    for (uint8_t idx = 0; idx < FEE_WORDS; idx++) {
+        uint32_t w = (idx == new_idx) ? new_word : fee_cache_word(idx);
+        if (w == 0) continue;
+        if (Flash_ProgramDoubleWord(&page[slot * 2U], FEE_REC_TAG | idx, w) != 0) return -1;
+        slot++;
+    }
+    if (Flash_ProgramDoubleWord(&page[0], FEE_PAGE_MAGIC, fee_sequence + 1U) != 0) return -1;
+
+    fee_active = target;
+    fee_sequence++;
+    fee_next = slot;
+    return 0;
+}
+
+/* Returns -1 when neither page could be formatted */
+static int fee_init(void) {
+    bool v0 = fee_page_valid(0);
+    bool v1 = fee_page_valid(1);
+
+    for (uint16_t i = 0; i < FEE_SIZE; i++) fee_cache[i] = 0;
+
+    if (v0 || v1) {
+        /* A swap leaves the old page valid until the next swap erases it,
+           so both are valid after every swap: newer sequence wins */
+        if (v0 && v1) fee_active = (fee_page(1)[1] > fee_page(0)[1]) ? 1 : 0;
+        else fee_active = v1 ? 1 : 0;
+        fee_sequence = fee_page(fee_active)[1];
+        fee_replay();
+        return 0;
+    }
+
+    /* Blank or foreign contents: format page 0, page 1 if that fails */
+    int r = -1;
+    Flash_Unlock();
+    for (uint8_t n = 0; n < 2U && r != 0; n++) {
+        r = (Flash_ErasePage(fee_page(n)) == 0 &&
+             Flash_ProgramDoubleWord(fee_page(n), FEE_PAGE_MAGIC, 1) == 0) ? 0 : -1;
+        fee_active = n;
+    }
+    Flash_Lock();
+    fee_sequence = 1;
+    fee_next = 1;
+    return r;
+}
+
+static int fee_update(uint16_t addr, const uint8_t *data, uint16_t len, uint16_t *written) {
+    uint16_t count = 0;
+    int r = 0;
+
+    if (addr < STORAGE_FLASH_BASE || addr + len > EEPROM_SIZE) return -1;
+    addr -= STORAGE_FLASH_BASE;
+
+    Flash_Unlock();
+    while (len > 0) {
+        uint8_t idx = (uint8_t)(addr / 4U);
+        uint8_t off = (uint8_t)(addr % 4U);
+        uint8_t n = (uint8_t)((len < 4U - off) ? len : 4U - off);
+        uint8_t changed = 0;
+        uint32_t w = fee_cache_word(idx);
+
+        for (uint8_t i = 0; i < n; i++) {
+            uint8_t shift = (uint8_t)((off + i) * 8U);
+            if ((uint8_t)(w >> shift) != data[i]) {
+                w = (w & ~(0xFFUL << shift)) | ((uint32_t)data[i] << shift);
+                changed++;
+            }
+        }
+        if (changed) {
+            /* The cache takes the word only once it is in flash */
+            if (fee_next >= FEE_SLOTS) {
+                r = fee_swap(idx, w);
+            } else {
+                const uint32_t *slot = &fee_page(fee_active)[fee_next * 2U];
+                r = Flash_ProgramDoubleWord(slot, FEE_REC_TAG | idx, w);
+                /* A slot half written by a failed program is used up */
+                if (r == 0 || slot[0] != FEE_ERASED || slot[1] != FEE_ERASED) fee_next++;
+            }
+            if (r != 0) break;
+            for (uint8_t b = 0; b < 4U; b++) fee_cache[idx * 4U + b] = (uint8_t)(w >> (b * 8U));
+            count += changed;
+        }
+
+        addr += n;
+        data += n;
+        len -= n;
+    }
+    Flash_Lock();
+
+    if (written) *written = count;
+    return r;
+}
+#endif /* STORAGE_BACKEND != STORAGE_BACKEND_EEPROM */
+
+void storage_init(void) {
+    uint8_t probe;
+
+    /* A missing 24C02 NACKs its address; the read fails after the I2C timeout */
+    eeprom_present = (eeprom_read_byte(0, &probe) == 0);
+
+#if STORAGE_BACKEND == STORAGE_BACKEND_EEPROM
+    backend = STORAGE_EEPROM;
+#else
+#if STORAGE_BACKEND == STORAGE_BACKEND_FLASH
+    backend = STORAGE_FLASH;
+#else
+    backend = eeprom_present ? STORAGE_EEPROM : STORAGE_FLASH;
+#endif
+    /* No storage rather than records on an unformatted page */
+    if (backend == STORAGE_FLASH && fee_init() != 0) backend = STORAGE_NONE;
+#endif
+}
+
+Storage_Backend_t storage_backend(void) {
+    return backend;
+}
+
+const char *storage_backend_name(void) {
+    switch (backend) {
+        case STORAGE_EEPROM: return "24C02 EEPROM";
+        case STORAGE_FLASH:  return "MCU flash (emulated)";
+        default:             return "none";
+    }
+}
+
+bool storage_eeprom_present(void) {
+    return eeprom_present;
+}
+
+static int store_read(uint16_t addr, uint8_t *buf, uint16_t len) {
+    if (backend == STORAGE_NONE) return -1;
+#if STORAGE_BACKEND != STORAGE_BACKEND_EEPROM
+    if (backend == STORAGE_FLASH) {
+        if (addr < STORAGE_FLASH_BASE || addr + len > EEPROM_SIZE) return -1;
+        for (uint16_t i = 0; i < len; i++) buf[i] = fee_cache[addr - STORAGE_FLASH_BASE + i];
+        return 0;
+    }
+#endif
+    return eeprom_read_block(addr, buf, len);
+}
+
+static int store_update(uint16_t addr, const uint8_t *data, uint16_t len, uint16_t *written) {
+    if (backend == STORAGE_NONE) return -1;
+#if STORAGE_BACKEND != STORAGE_BACKEND_EEPROM
+    if (backend == STORAGE_FLASH) return fee_update(addr, data, len, written);
+#endif
+    return eeprom_update_block(addr, data, len, written);
+}
+
+/* Writes are traced with their duration. Reads only when they fail: user
+   patterns and CW text are read from storage all the time they play */
+int storage_read(uint16_t addr, uint8_t *buf, uint16_t len) {
+    uint32_t t0 = micros();
+    watchdog_begin(WATCHDOG_STORAGE);
+    int r = store_read(addr, buf, len);
+    watchdog_end(WATCHDOG_STORAGE);
+    if (r != 0) {
+        trace(TRACE_STORE_READ, len > 0xFFU ? 0xFFU : (uint8_t)len, addr);
+        trace(TRACE_STORE_DONE, 1, trace_since(t0));
+    }
+    return r;
+}
+
+int storage_update(uint16_t addr, const uint8_t *data, uint16_t len, uint16_t *written) {
+    uint32_t t0 = micros();
+    trace(TRACE_STORE_WRITE, len > 0xFFU ? 0xFFU : (uint8_t)len, addr);
+    watchdog_begin(WATCHDOG_STORAGE);
+    int r = store_update(addr, data, len, written);
+    watchdog_end(WATCHDOG_STORAGE);
+    trace(TRACE_STORE_DONE, r != 0, trace_since(t0));
+    return r;
+}
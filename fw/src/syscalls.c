@@ -10,15 +10,18 @@
 #include <unistd.h>
 
 #include "stm32c0xx.h"
+#include "mem.h"
+
+extern uint8_t _end; /* defined in linker script */
+
+static uint8_t *heap_end = NULL;
 
 /* Provide _sbrk using linker symbols defined in the project's linker script */
 void *_sbrk(ptrdiff_t incr)
 {
-    extern uint8_t _end; /* defined in linker script */
     extern uint8_t _estack; /* top of RAM */
     extern uint32_t _Min_Stack_Size; /* reserved stack size */
 
-    static uint8_t *heap_end = NULL;
     uint8_t *prev_heap_end;
 
     const uint32_t stack_limit = (uint32_t)&_estack - (uint32_t)&_Min_Stack_Size;
@@ -39,6 +42,12 @@ void *_sbrk(ptrdiff_t incr)
     return (void *)prev_heap_end;
 }
 
+/* Heap handed out so far, for 'mem' */
+uint32_t sbrk_used(void)
+{
+    return heap_end ? (uint32_t)(heap_end - &_end) : 0;
+}
+
 /* Simple write: route stdout/stderr to USART1 (blocking) */
 int _write(int fd, const char *buf, int len)
 {
@@ -2,9 +2,21 @@
 
 #include "system.h"
 #include "config.h"
+#include "timer.h"
+#include "uart.h"
+#include "i2c.h"
+#include "log.h"
+#include "trace.h"
+#include "bootloader.h"
 #include "stm32c011xx.h"
 #include <stdint.h>
 
+#define HSIDIV_ECO      2U      /* HSI48 / 4 */
+#define HSIDIV_PERF     0U      /* HSI48 / 1 */
+
+static uint32_t sysclk_hz = SYSTEM_CLOCK_HZ;
+static uint8_t clock_profile = CLOCK_ECO;
+
 void System_ClockConfig(void) {
     /* Enable HSI (12 MHz internal RC oscillator) */
     RCC->CR |= RCC_CR_HSION;
@@ -15,7 +27,48 @@ void System_ClockConfig(void) {
 }
 
 uint32_t System_GetClock(void) {
-    return SYSTEM_CLOCK_HZ;
+    return sysclk_hz;
+}
+
+int System_SetClockProfile(uint8_t profile) {
+    if (profile >= CLOCK_PROFILES) return -1;
+    if (profile == clock_profile) return 0;
+
+    UART_Flush();       /* A character on the wire would change speed halfway */
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (profile == CLOCK_PERF) {
+        /* Wait states before the clock goes up (1 WS above 24 MHz) */
+        FLASH->ACR = (FLASH->ACR & ~FLASH_ACR_LATENCY) | (1U << FLASH_ACR_LATENCY_Pos);
+        while ((FLASH->ACR & FLASH_ACR_LATENCY) != (1U << FLASH_ACR_LATENCY_Pos));
+        RCC->CR = (RCC->CR & ~RCC_CR_HSIDIV) | (HSIDIV_PERF << RCC_CR_HSIDIV_Pos);
+        sysclk_hz = SYSTEM_CLOCK_PERF_HZ;
+    } else {
+        /* ... and removed only after it came down */
+        RCC->CR = (RCC->CR & ~RCC_CR_HSIDIV) | (HSIDIV_ECO << RCC_CR_HSIDIV_Pos);
+        FLASH->ACR &= ~FLASH_ACR_LATENCY;
+        sysclk_hz = SYSTEM_CLOCK_HZ;
+    }
+    SystemCoreClock = sysclk_hz;
+    clock_profile = profile;
+
+    Timer_ClockUpdate();
+    UART_ClockUpdate();
+    __set_PRIMASK(primask);
+
+    i2c_clock_update();     /* Polled from the main loop, never mid-transfer here */
+    trace(TRACE_CLOCK, profile, (uint16_t)(sysclk_hz / 1000000U));
+    LOG("clock: profile %u, %u Hz", profile, sysclk_hz);
+    return 0;
+}
+
+uint8_t System_GetClockProfile(void) {
+    return clock_profile;
+}
+
+const char *System_ClockProfileName(uint8_t profile) {
+    return profile == CLOCK_PERF ? "perf" : "eco";
 }
 
 void System_Init(void) {
@@ -24,3 +77,19 @@ void System_Init(void) {
     System_ClockConfig();
 }
 
+void System_Sleep(void) {
+    __WFI();
+}
+
+void System_Reset(void) {
+    NVIC_SystemReset();
+    while (1);
+}
+
+void System_EnterBootloader(void) {
+    __disable_irq();
+    BOOT_REQUEST->flags = uart2_enabled ? BOOT_REQUEST_UART2 : 0U;
+    BOOT_REQUEST->magic = BOOT_REQUEST_MAGIC;
+    NVIC_SystemReset();
+    while (1);
+}
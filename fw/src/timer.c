@@ -167,9 +167,23 @@ void PWM_SetDutyCycle(uint8_t channel, uint8_t duty_cycle) {
 #include "stm32c011xx.h"
 #include "gpio.h"
 #include "pins.h"
-/* TODO: Implement for STM32C011 */
+#include "bcm.h"
+#include "pattern.h"
+#include "button.h"
+#include "event.h"
+#include "watchdog.h"
 
 static volatile uint32_t systick_ms = 0;
+/* Parts of a millisecond counted before a clock change restarted the
+   SysTick period, so micros() carries on from where it was */
+static uint32_t systick_us_offset = 0;
+/* Microseconds per SysTick count, 16.16 fixed point: micros() needs no
+   divide, which the M0+ would call from libgcc in flash */
+static uint32_t systick_us_scale = 0;
+
+static void systick_set_scale(uint32_t load) {
+    systick_us_scale = (1000UL << 16) / (load + 1U);
+}
 
 /* SysTick-based millisecond tick for SRAL-SAO2 (STM32C0) */
 void Timer_Init(void) {
@@ -182,28 +196,51 @@ void Timer_Init(void) {
 
     SysTick->LOAD = ticks - 1U;
     SysTick->VAL = 0U;
+    systick_set_scale(ticks - 1U);
     /* CLKSOURCE = processor clock, TICKINT = enable, ENABLE = enable counter */
     SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
 }
 
-void SysTick_Handler(void) {
-    systick_ms++;
-}
+void Timer_ClockUpdate(void) {
+    uint32_t clk = System_GetClock();
+    uint32_t load = SysTick->LOAD;
+    uint32_t val = SysTick->VAL;
 
-void delay_us(uint32_t us) {
-    /* Approximate microsecond delay using SysTick counter resolution (1 ms).
-       For sub-ms accuracy this is a simple busy-wait calibrated loop fallback. */
-    if (us >= 1000U) {
-        uint32_t ms = us / 1000U;
-        delay_ms(ms);
-        us = us % 1000U;
+    /* A write to VAL restarts the period at the new LOAD. The part of the
+       current millisecond already counted goes into the offset; a tick
+       pending from a wrap is still taken once interrupts are enabled. */
+    SysTick->LOAD = clk / 1000U - 1U;
+    SysTick->VAL = 0U;
+    systick_us_offset += ((load - val) * systick_us_scale) >> 16;
+    systick_set_scale(clk / 1000U - 1U);
+
+    /* BCM planes: the new prescaler is taken at the next plane boundary, so
+       one plane runs at the wrong length */
+    if (TIM14->CR1 & TIM_CR1_CEN) TIM14->PSC = clk / 1000000U - 1U;
+
+    /* CW keying: restart the count with the new prescaler and keep the time
+       left to the next edge */
+    if (TIM17->CR1 & TIM_CR1_CEN) {
+        uint16_t left = (TIM17->SR & TIM_SR_CC1IF) ? 0U : (uint16_t)(TIM17->CCR1 - TIM17->CNT);
+        TIM17->PSC = clk / 1000U - 1U;
+        TIM17->EGR = TIM_EGR_UG;        /* Clears CNT, no interrupt (only CC1IE) */
+        TIM17->CCR1 = left;
     }
 
-    /* Short busy-wait calibrated loop for remaining microseconds.
-       Calibration: assume core ~ SYSTEM_CLOCK_HZ; simple tight loop */
-    volatile uint32_t count = (System_GetClock() / 1000000U) * us / 6U; /* rough cycles/loop */
-    while (count--) {
-        __asm volatile ("nop");
+    /* The main loop arms the wake-up again before it sleeps */
+    Wake_TimerStop();
+}
+
+RAMFUNC void SysTick_Handler(void) {
+    systick_ms++;
+    button_tick(systick_ms);    /* Same priority as EXTI, neither preempts the other */
+    watchdog_tick();
+}
+
+RAMFUNC void delay_us(uint32_t us) {
+    uint32_t start = micros();
+    while ((micros() - start) < us) {
+        /* busy-wait */
     }
 }
 
@@ -214,14 +251,24 @@ void delay_ms(uint32_t ms) {
     }
 }
 
-uint32_t micros(void) {
-    /* Return milliseconds * 1000 (approx). Not exact sub-ms value. */
-    return systick_ms * 1000U;
+RAMFUNC uint32_t micros(void) {
+    /* Millisecond tick, the carry from clock changes and the elapsed part of
+       the current SysTick period. Re-read if the tick interrupt ran in
+       between. */
+    uint32_t ms, val;
+    do {
+        ms = systick_ms;
+        val = SysTick->VAL;
+    } while (ms != systick_ms);
+    uint32_t load = SysTick->LOAD;
+    /* From an interrupt that blocks SysTick: the counter may have wrapped
+       with the tick not yet counted */
+    if ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) && val > load / 2U) ms++;
+    /* The product stays below 1000 << 16 at any clock */
+    return ms * 1000U + systick_us_offset + (((load - val) * systick_us_scale) >> 16);
 }
 
-/* Minimal PWM stubs for SRAL_SAO2 to satisfy references from main/CLI.
-   These provide simple on/off control using GPIO pins since the
-   small STM32C0 device may not have the same timers configured yet. */
+/* LED brightness: PWM channels 1..5 map to LED1..LED5 on the BCM driver */
 void PWM_Init(void) {
     /* Enable GPIO clocks for LED ports and configure pins as outputs */
     GPIO_ClockEnable(LED1_GPIO_PORT);
@@ -238,32 +285,103 @@ void PWM_Init(void) {
 }
 
 void PWM_SetDutyCycle(uint8_t channel, uint8_t duty_cycle) {
-    /* Simple threshold-based on/off PWM emulation */
-    (void)duty_cycle;
-    switch (channel) {
-        case 1:
-            if (duty_cycle > 128) GPIO_SetPin(LED1_GPIO_PORT, LED1_GPIO_PIN);
-            else GPIO_ClearPin(LED1_GPIO_PORT, LED1_GPIO_PIN);
-            break;
-        case 2:
-            if (duty_cycle > 128) GPIO_SetPin(LED2_GPIO_PORT, LED2_GPIO_PIN);
-            else GPIO_ClearPin(LED2_GPIO_PORT, LED2_GPIO_PIN);
-            break;
-        case 3:
-            if (duty_cycle > 128) GPIO_SetPin(LED3_GPIO_PORT, LED3_GPIO_PIN);
-            else GPIO_ClearPin(LED3_GPIO_PORT, LED3_GPIO_PIN);
-            break;
-        case 4:
-            if (duty_cycle > 128) GPIO_SetPin(LED4_GPIO_PORT, LED4_GPIO_PIN);
-            else GPIO_ClearPin(LED4_GPIO_PORT, LED4_GPIO_PIN);
-            break;
-        case 5:
-            if (duty_cycle > 128) GPIO_SetPin(LED5_GPIO_PORT, LED5_GPIO_PIN);
-            else GPIO_ClearPin(LED5_GPIO_PORT, LED5_GPIO_PIN);
-            break;
-        default:
-            break;
+    if (channel >= 1 && channel <= BCM_LEDS) BCM_SetLevel(channel - 1, duty_cycle);
+}
+
+/* BCM plane timer: TIM14 counting at 1 MHz, ARR preloaded one plane ahead so
+   interrupt latency never stretches a plane */
+void BCM_TimerStart(uint16_t first_us, uint16_t next_us) {
+    RCC->APBENR2 |= RCC_APBENR2_TIM14EN;
+    TIM14->CR1 = 0;
+    TIM14->PSC = System_GetClock() / 1000000U - 1U;
+    TIM14->ARR = first_us - 1U;
+    TIM14->CNT = 0;
+    TIM14->EGR = TIM_EGR_UG;            /* Load PSC and ARR now */
+    TIM14->SR = 0;
+    TIM14->CR1 = TIM_CR1_ARPE;
+    TIM14->ARR = next_us - 1U;          /* Taken over at the first update */
+    TIM14->DIER = TIM_DIER_UIE;
+    NVIC_SetPriority(TIM14_IRQn, 0);    /* Above UART and EXTI: planes stay exact */
+    NVIC_ClearPendingIRQ(TIM14_IRQn);
+    NVIC_EnableIRQ(TIM14_IRQn);
+    TIM14->CR1 |= TIM_CR1_CEN;
+}
+
+void BCM_TimerStop(void) {
+    TIM14->CR1 = 0;
+    TIM14->DIER = 0;
+    NVIC_DisableIRQ(TIM14_IRQn);
+    TIM14->SR = 0;
+}
+
+RAMFUNC void TIM14_IRQHandler(void) {
+    TIM14->SR = ~TIM_SR_UIF;
+    TIM14->ARR = BCM_NextPlane() - 1U;
+}
+
+/* CW keying timer: TIM17 free-running at 1 kHz, output compare 1 moved
+   forward from its previous value, so interrupt latency does not add up */
+void CW_TimerStart(uint16_t first_ms) {
+    RCC->APBENR2 |= RCC_APBENR2_TIM17EN;
+    TIM17->CR1 = 0;
+    TIM17->PSC = System_GetClock() / 1000U - 1U;
+    TIM17->ARR = 0xFFFFU;
+    TIM17->CNT = 0;
+    TIM17->EGR = TIM_EGR_UG;            /* Load PSC now */
+    TIM17->CCR1 = first_ms;
+    TIM17->SR = 0;
+    TIM17->DIER = TIM_DIER_CC1IE;
+    NVIC_SetPriority(TIM17_IRQn, 1);
+    NVIC_ClearPendingIRQ(TIM17_IRQn);
+    NVIC_EnableIRQ(TIM17_IRQn);
+    TIM17->CR1 = TIM_CR1_CEN;
+}
+
+void CW_TimerStop(void) {
+    TIM17->CR1 = 0;
+    TIM17->DIER = 0;
+    NVIC_DisableIRQ(TIM17_IRQn);
+    TIM17->SR = 0;
+}
+
+void TIM17_IRQHandler(void) {
+    TIM17->SR = ~TIM_SR_CC1IF;
+    uint16_t next_ms = pattern_cw_next();
+    if (next_ms) {
+        TIM17->CCR1 = (uint16_t)(TIM17->CCR1 + next_ms);
+    } else {
+        CW_TimerStop();
     }
 }
 
+/* Wake-up timer: TIM16 in one-pulse mode, the update at the end of the
+   single period posts the event */
+void Wake_TimerStart(uint16_t us) {
+    if (us < 2U) us = 2U;
+    RCC->APBENR2 |= RCC_APBENR2_TIM16EN;
+    TIM16->CR1 = 0;
+    TIM16->PSC = System_GetClock() / 1000000U - 1U;
+    TIM16->ARR = us - 1U;
+    TIM16->CNT = 0;
+    TIM16->EGR = TIM_EGR_UG;            /* Load PSC now */
+    TIM16->SR = 0;
+    TIM16->DIER = TIM_DIER_UIE;
+    NVIC_SetPriority(TIM16_IRQn, 3);    /* Only wakes the main loop */
+    NVIC_ClearPendingIRQ(TIM16_IRQn);
+    NVIC_EnableIRQ(TIM16_IRQn);
+    TIM16->CR1 = TIM_CR1_OPM | TIM_CR1_CEN;
+}
+
+void Wake_TimerStop(void) {
+    TIM16->CR1 = 0;
+    TIM16->DIER = 0;
+    TIM16->SR = 0;
+    NVIC_ClearPendingIRQ(TIM16_IRQn);
+}
+
+void TIM16_IRQHandler(void) {
+    TIM16->SR = ~TIM_SR_UIF;
+    event_post(EVENT_TIMER, EVENT_SRC_WAKE, 0, micros());
+}
+
 #endif
@@ -0,0 +1,79 @@
+/* Event trace ring, kept over a soft reset */
+
+#include "trace.h"
+#include "config.h"
+#include "irq.h"
+#include "timer.h"
+
+#define TRACE_MAGIC         0x54524331UL    /* "TRC1" */
+
+/* Not cleared by the startup code; the magic and the check of head and
+   count tell a kept ring from power-on garbage */
+static struct {
+    uint32_t magic;
+    uint8_t head;
+    uint8_t count;
+    trace_entry_t e[TRACE_ENTRIES];
+} ring NOINIT;
+
+static const char * const names[TRACE_TYPES] = {
+    [TRACE_BOOT] = "boot",
+    [TRACE_MODE] = "mode",
+    [TRACE_BUTTON] = "button",
+    [TRACE_STORE_READ] = "store rd",
+    [TRACE_STORE_WRITE] = "store wr",
+    [TRACE_STORE_DONE] = "store done",
+    [TRACE_UART_OVERRUN] = "uart overrun",
+    [TRACE_CMD] = "cmd",
+    [TRACE_CMD_DONE] = "cmd done",
+    [TRACE_CLOCK] = "clock",
+    [TRACE_POWER] = "power",
+    [TRACE_FAULT] = "fault",
+    [TRACE_STACK] = "stack guard",
+    [TRACE_WATCHDOG] = "watchdog",
+};
+
+void trace_init(void) {
+    bool kept = ring.magic == TRACE_MAGIC && ring.head < TRACE_ENTRIES &&
+                ring.count <= TRACE_ENTRIES;
+    if (!kept) trace_clear();
+    trace(TRACE_BOOT, kept, 0);
+}
+
+void trace(uint8_t type, uint8_t a, uint16_t arg) {
+    uint32_t primask = irq_save();
+    uint8_t i = ring.head;
+    ring.e[i] = (trace_entry_t){ irq_now_us(), arg, type, a };
+    ring.head = (uint8_t)((i + 1U) % TRACE_ENTRIES);
+    if (ring.count < TRACE_ENTRIES) ring.count++;
+    irq_restore(primask);
+}
+
+uint16_t trace_since(uint32_t t0_us) {
+    uint32_t us = micros() - t0_us;
+    return us > 0xFFFFU ? 0xFFFFU : (uint16_t)us;
+}
+
+uint8_t trace_count(void) {
+    return ring.count;
+}
+
+bool trace_get(uint8_t i, trace_entry_t *e) {
+    uint32_t primask = irq_save();
+    bool ok = i < ring.count;
+    if (ok) *e = ring.e[(ring.head + TRACE_ENTRIES - ring.count + i) % TRACE_ENTRIES];
+    irq_restore(primask);
+    return ok;
+}
+
+const char *trace_type_name(uint8_t type) {
+    return type < TRACE_TYPES ? names[type] : "?";
+}
+
+void trace_clear(void) {
+    uint32_t primask = irq_save();
+    ring.head = 0;
+    ring.count = 0;
+    ring.magic = TRACE_MAGIC;
+    irq_restore(primask);
+}
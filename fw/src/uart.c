@@ -5,6 +5,10 @@
 #include "config.h"
 #include "pins.h"
 #include "system.h"
+#include "timer.h"
+#include "event.h"
+#include "log.h"
+#include "trace.h"
 
 #include "stm32c011xx.h"
 #include <stdbool.h>
@@ -12,6 +16,13 @@
 /* Global flag to indicate if USART2 on SAO connector is enabled */
 bool uart2_enabled = false;
 
+static uint32_t uart_baud = UART_BAUDRATE;
+
+/* Oversampling by 16: BRR is the clock divided by the baud rate */
+static uint32_t uart_brr(uint32_t baud) {
+    return (System_GetClock() + baud / 2U) / baud;
+}
+
 /* Simple blocking transmit using USART2 TDR/ISR flags */
 void UART_Init(void) {
     /* Enable GPIO clocks for TX/RX pins */
@@ -40,8 +51,7 @@ void UART_Init(void) {
     UART_PERIPHERAL->CR2 = 0;
     UART_PERIPHERAL->CR3 = 0;
 
-    uint32_t pclk = System_GetClock();
-    UART_PERIPHERAL->BRR = pclk / UART_BAUDRATE;
+    UART_PERIPHERAL->BRR = uart_brr(uart_baud);
 
     /* Enable transmitter and receiver */
     UART_PERIPHERAL->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
@@ -64,6 +74,40 @@ void UART_SendChar(char c) {
     /* Wait for TC if strict completion needed */
 }
 
+void UART_Flush(void) {
+    while (!(UART_PERIPHERAL->ISR & USART_ISR_TC));
+    if (uart2_enabled) {
+        while (!(USART2->ISR & USART_ISR_TC));
+    }
+}
+
+/* BRR can only be written with the USART disabled */
+static void uart_set_brr(USART_TypeDef *usart, uint32_t brr) {
+    uint32_t cr1 = usart->CR1;
+    usart->CR1 = cr1 & ~USART_CR1_UE;
+    usart->BRR = brr;
+    usart->CR1 = cr1;
+}
+
+int UART_SetBaud(uint32_t baud) {
+    if (baud == 0) return -1;
+    uint32_t brr = uart_brr(baud);
+    if (brr < 16U || brr > 0xFFFFU) return -1;
+    UART_Flush();
+    uart_set_brr(UART_PERIPHERAL, brr);
+    if (uart2_enabled) uart_set_brr(USART2, brr);
+    uart_baud = baud;
+    return 0;
+}
+
+uint32_t UART_GetBaud(void) {
+    return uart_baud;
+}
+
+void UART_ClockUpdate(void) {
+    if (UART_SetBaud(uart_baud) != 0) UART_SetBaud(UART_BAUDRATE);
+}
+
 void UART_SendString(const char *str) {
     while (*str) UART_SendChar(*str++);
 }
@@ -88,19 +132,41 @@ uint32_t UART_Available(void) {
     return (uart_rx_head - uart_rx_tail + UART_RX_BUFFER_SIZE) % UART_RX_BUFFER_SIZE;
 }
 
-void UART_IRQHandler(void) {
-    if (UART_PERIPHERAL->ISR & USART_ISR_RXNE_RXFNE) {
-        uint8_t d = UART_PERIPHERAL->RDR;
-        uint32_t next = (uart_rx_head + 1) % UART_RX_BUFFER_SIZE;
-        if (next != uart_rx_tail) {
-            uart_rx_buffer[uart_rx_head] = d;
-            uart_rx_head = next;
-        }
+/* From the RX interrupts: the main loop hears about the first byte in an
+   empty ring and reads until it is empty again. It also reads on every
+   pass, so a post lost to a full queue only delays the input */
+static RAMFUNC void uart_rx_put(uint8_t d, uint8_t source) {
+    uint32_t head = uart_rx_head;
+    uint32_t next = (head + 1) % UART_RX_BUFFER_SIZE;
+    if (next == uart_rx_tail) {
+        trace(TRACE_UART_OVERRUN, source, 0);
+        LOG("uart%u: rx overrun", source);
+        return;
     }
+    uart_rx_buffer[head] = d;
+    uart_rx_head = next;
+    if (head == uart_rx_tail) event_post(EVENT_UART_RX, source, d, micros());
+}
+
+static RAMFUNC void uart_rx_irq(USART_TypeDef *uart, uint8_t source) {
+    uint32_t isr = uart->ISR;
+    if (isr & USART_ISR_ORE) {
+        /* A byte arrived before the previous one was read. The flag keeps
+           the RX interrupt pending until it is cleared */
+        uart->ICR = USART_ICR_ORECF;
+        trace(TRACE_UART_OVERRUN, source, 1);
+    }
+    if (isr & USART_ISR_RXNE_RXFNE) {
+        uart_rx_put(uart->RDR, source);
+    }
+}
+
+RAMFUNC void UART_IRQHandler(void) {
+    uart_rx_irq(UART_PERIPHERAL, 1);
 }
 
 /* IRQ wrapper: startup vectors expect USART1_IRQHandler for this board */
-void USART1_IRQHandler(void) {
+RAMFUNC void USART1_IRQHandler(void) {
     UART_IRQHandler();
 }
 
@@ -130,8 +196,7 @@ void UART2_Init(void) {
     USART2->CR2 = 0;
     USART2->CR3 = 0;
 
-    uint32_t pclk = System_GetClock();
-    USART2->BRR = pclk / UART_BAUDRATE;
+    USART2->BRR = uart_brr(uart_baud);
 
     /* Enable transmitter and receiver */
     USART2->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
@@ -144,13 +209,6 @@ void UART2_Init(void) {
 }
 
 /* USART2 IRQ Handler - receives from SAO connector UART */
-void USART2_IRQHandler(void) {
-    if (USART2->ISR & USART_ISR_RXNE_RXFNE) {
-        uint8_t d = USART2->RDR;
-        uint32_t next = (uart_rx_head + 1) % UART_RX_BUFFER_SIZE;
-        if (next != uart_rx_tail) {
-            uart_rx_buffer[uart_rx_head] = d;
-            uart_rx_head = next;
-        }
-    }
+RAMFUNC void USART2_IRQHandler(void) {
+    uart_rx_irq(USART2, 2);
 }
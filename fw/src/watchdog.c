@@ -0,0 +1,134 @@
+/* Task supervision on the independent watchdog */
+
+#include <stdbool.h>
+#include "watchdog.h"
+#include "config.h"
+#include "fault.h"
+#include "trace.h"
+
+#ifndef BOARD_SIM
+#include "stm32c011xx.h"
+
+#define IWDG_KEY_REFRESH    0xAAAAU
+#define IWDG_KEY_UNLOCK     0x5555U
+#define IWDG_KEY_START      0xCCCCU
+#define IWDG_PR_DIV32       3U      /* 32 kHz LSI / 32: 1 ms per count */
+
+#define iwdg_refresh()      (IWDG->KR = IWDG_KEY_REFRESH)
+#else
+#include <stdio.h>
+#include "sim.h"
+
+#define iwdg_refresh()      ((void)0)
+#endif
+
+#define WATCHDOG_MAGIC      0x57444731UL    /* "WDG1" */
+
+static const uint16_t deadline_ms[WATCHDOG_TASKS] = {
+    [WATCHDOG_CLI] = WATCHDOG_CLI_MS,
+    [WATCHDOG_LED] = WATCHDOG_LED_MS,
+    [WATCHDOG_STORAGE] = WATCHDOG_STORAGE_MS,
+};
+
+static const char * const names[WATCHDOG_TASKS + 1] = {
+    [WATCHDOG_CLI] = "CLI",
+    [WATCHDOG_LED] = "LED engine",
+    [WATCHDOG_STORAGE] = "storage",
+    [WATCHDOG_NONE] = "system tick",
+};
+
+/* Tick of the last watchdog_begin(), 0 while the task is idle */
+static volatile uint32_t started[WATCHDOG_TASKS];
+static volatile uint32_t now_ms = 1;    /* Never 0 */
+static bool running;
+
+/* Survives the reset it causes. starved is set by the tick that stops
+   refreshing; the next boot moves it to last */
+static struct {
+    uint32_t magic;
+    uint32_t resets;
+    uint32_t last_boot;
+    uint8_t starved;
+    uint8_t last;
+} rec NOINIT;
+
+void watchdog_init(void) {
+    if (rec.magic != WATCHDOG_MAGIC || (fault_reset_flags() & FAULT_RESET_POWER)) {
+        rec.magic = WATCHDOG_MAGIC;
+        rec.resets = 0;
+        rec.last_boot = 0;
+        rec.last = WATCHDOG_NONE;
+        rec.starved = WATCHDOG_NONE;
+    }
+    if (fault_reset_flags() & FAULT_RESET_IWDG) {
+        rec.resets++;
+        rec.last = rec.starved < WATCHDOG_TASKS ? rec.starved : WATCHDOG_NONE;
+        rec.last_boot = fault_boots() - 1U;
+    }
+    rec.starved = WATCHDOG_NONE;
+
+#ifndef BOARD_SIM
+    /* Stopped while the core is halted in the debugger */
+    RCC->APBENR1 |= RCC_APBENR1_DBGEN;
+    DBG->APBFZ1 |= DBG_APB_FZ1_DBG_IWDG_STOP;
+
+    IWDG->KR = IWDG_KEY_START;      /* Also starts the LSI */
+    IWDG->KR = IWDG_KEY_UNLOCK;
+    IWDG->PR = IWDG_PR_DIV32;
+    IWDG->RLR = WATCHDOG_IWDG_MS - 1U;
+    while (IWDG->SR != 0U) {
+        /* PR and RLR take a few LSI cycles to update */
+    }
+    iwdg_refresh();
+#endif
+    running = true;
+}
+
+/* Check the tasks and refresh the IWDG while all of them keep up; once
+   one overruns, record it and let the IWDG expire */
+RAMFUNC void watchdog_tick(void) {
+    uint32_t now = now_ms + 1U;
+    if (now == 0U) now = 1U;
+    now_ms = now;
+    if (!running) return;
+
+    for (uint8_t i = 0; i < WATCHDOG_TASKS; i++) {
+        uint32_t t0 = started[i];
+        if (t0 != 0U && now - t0 > deadline_ms[i]) {
+            running = false;
+            rec.starved = i;
+            trace(TRACE_WATCHDOG, i, (uint16_t)(now - t0));
+#ifdef BOARD_SIM
+            /* No IWDG: end the run, failing the scenario */
+            fprintf(stderr, "[sim] watchdog reset, %s starved\n", names[i]);
+            sim_stop(1);
+#endif
+            return;
+        }
+    }
+    iwdg_refresh();
+}
+
+void watchdog_begin(watchdog_task_t task) {
+    started[task] = now_ms;
+}
+
+void watchdog_end(watchdog_task_t task) {
+    started[task] = 0;
+}
+
+uint32_t watchdog_resets(void) {
+    return rec.resets;
+}
+
+watchdog_task_t watchdog_last_task(void) {
+    return (watchdog_task_t)rec.last;
+}
+
+uint32_t watchdog_last_boot(void) {
+    return rec.last_boot;
+}
+
+const char *watchdog_task_name(watchdog_task_t task) {
+    return task <= WATCHDOG_NONE ? names[task] : "?";
+}
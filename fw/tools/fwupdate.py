@@ -0,0 +1,252 @@
+#!/usr/bin/env python3
+"""Update SRAL-SAO2 firmware over a UART through the bootloader (include/bootloader.h).
+
+    tools/fwupdate.py /dev/ttyUSB0 [build/SRAL-SAO2.bin] [-s 921600]
+    tools/fwupdate.py /dev/ttyUSB0 --no-reboot      # badge already in the bootloader
+    tools/fwupdate.py --combine build/bootloader/bootloader.bin build/SRAL-SAO2.bin -o full.bin
+
+The badge is sent 'reboot dfu' on its console first, then the image goes
+in CRC-checked blocks, a window of them in flight, at the transfer baud
+rate. The bootloader checks the CRC of the whole image before it writes
+the record that lets it start the application. --combine builds the
+bootloader, application and that record into one image for an ST-Link.
+Only the standard library is needed.
+"""
+
+import argparse
+import os
+import select
+import struct
+import sys
+import time
+import zlib
+
+SOF = 0xA5
+HELLO, BAUD, START, DATA, END, RUN = range(1, 7)
+ACK, NAK = 0x80, 0x40
+ERRORS = {1: "bad frame", 2: "out of order", 3: "out of range", 4: "flash error",
+          5: "image CRC mismatch", 6: "no complete image"}
+
+# Flash layout, as in include/bootloader.h
+BOOTLOADER_SIZE = 0x800
+APP_INFO = 0x6FF0           # Offset of app_info_t from the start of flash
+APP_INFO_MAGIC = 0x4F464E49
+
+
+class UpdateError(Exception):
+    pass
+
+
+def pad8(image):
+    return image + b"\xff" * (-len(image) % 8)
+
+
+class Link:
+    def __init__(self, path, baud):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        self.buf = bytearray()
+        self.set_baud(baud)
+
+    def set_baud(self, baud):
+        if not os.isatty(self.fd):
+            return
+        import termios
+        import tty
+        tty.setraw(self.fd)
+        attr = termios.tcgetattr(self.fd)
+        speed = getattr(termios, f"B{baud}", None)
+        if speed is None:
+            raise UpdateError(f"{baud} baud not supported by termios")
+        attr[4] = attr[5] = speed
+        termios.tcsetattr(self.fd, termios.TCSADRAIN, attr)
+
+    def write(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def drain(self, seconds):
+        """Discard what arrives for a while, console echo and the like."""
+        end = time.monotonic() + seconds
+        while self.read(end - time.monotonic()):
+            pass
+        self.buf.clear()
+
+    def read(self, timeout):
+        if timeout <= 0 or not select.select([self.fd], [], [], timeout)[0]:
+            return False
+        self.buf += os.read(self.fd, 4096)
+        return True
+
+    def send(self, ftype, seq, payload=b""):
+        body = struct.pack("<BHH", ftype, seq, len(payload)) + payload
+        self.write(bytes([SOF]) + body + struct.pack("<I", zlib.crc32(body)))
+
+    def frame(self):
+        """The next complete frame in the buffer as (type, seq, payload)."""
+        while True:
+            i = self.buf.find(SOF)
+            if i < 0:
+                self.buf.clear()
+                return None
+            del self.buf[:i]
+            if len(self.buf) < 6:
+                return None
+            ftype, seq, n = struct.unpack_from("<BHH", self.buf, 1)
+            if n > 256:
+                del self.buf[:1]
+                continue
+            if len(self.buf) < 10 + n:
+                return None
+            body = bytes(self.buf[1:6 + n])
+            crc, = struct.unpack_from("<I", self.buf, 6 + n)
+            if zlib.crc32(body) != crc:
+                del self.buf[:1]
+                continue
+            del self.buf[:10 + n]
+            return ftype, seq, body[5:]
+
+    def recv(self, timeout):
+        end = time.monotonic() + timeout
+        while True:
+            f = self.frame()
+            if f is not None:
+                return f
+            if not self.read(end - time.monotonic()):
+                return None
+
+    def request(self, ftype, payload=b"", timeout=1.0, tries=5):
+        """Send a command and wait for its ACK; NAK payload raises."""
+        for _ in range(tries):
+            self.send(ftype, 0, payload)
+            end = time.monotonic() + timeout
+            while True:
+                f = self.recv(end - time.monotonic())
+                if f is None:
+                    break
+                rtype, _, rpayload = f
+                if rtype == ACK | ftype:
+                    return rpayload
+                if rtype == NAK | ftype:
+                    err = rpayload[0] if rpayload else 0
+                    raise UpdateError(ERRORS.get(err, "refused"))
+        raise UpdateError("no answer from the bootloader")
+
+
+def stream(link, image, block, window, progress):
+    """DATA blocks, go-back-N: a NAK or a timeout resends from the first unacknowledged."""
+    blocks = [image[o:o + block] for o in range(0, len(image), block)]
+    base = nxt = timeouts = 0
+    while base < len(blocks):
+        while nxt < len(blocks) and nxt < base + window:
+            link.send(DATA, nxt, blocks[nxt])
+            nxt += 1
+        f = link.recv(1.0)
+        if f is None:
+            timeouts += 1
+            if timeouts > 10:
+                raise UpdateError(f"no answer at block {base}")
+            nxt = base
+            continue
+        rtype, seq, payload = f
+        if rtype == ACK | DATA:
+            if seq >= base:
+                base = seq + 1
+                timeouts = 0
+                progress(min(base * block, len(image)))
+        elif rtype == NAK | DATA:
+            err = payload[0] if payload else 0
+            if err not in (1, 2):
+                raise UpdateError(f"block {seq}: {ERRORS.get(err, 'refused')}")
+            base = max(base, seq)
+            nxt = base
+
+
+def update(args):
+    with open(args.image, "rb") as f:
+        image = pad8(f.read())
+    crc = zlib.crc32(image)
+
+    link = Link(args.port, args.baud)
+    if not args.no_reboot:
+        link.write(b"\rreboot dfu\r")
+        link.drain(0.5)
+
+    info = link.request(HELLO, timeout=0.3, tries=10)
+    version, window, block, base, size = struct.unpack("<BBHII", info[:12])
+    window = min(window, args.window) if args.window else window
+    print(f"bootloader v{version}: {size} bytes at {base:#010x}, "
+          f"{block}-byte blocks, window {window}")
+    if len(image) > size:
+        raise UpdateError(f"{args.image}: {len(image)} bytes, {size} fit")
+
+    if args.speed != args.baud:
+        link.request(BAUD, struct.pack("<I", args.speed))
+        time.sleep(0.01)
+        link.set_baud(args.speed)
+        link.drain(0.05)
+        link.request(HELLO, timeout=0.3, tries=5)
+
+    t0 = time.monotonic()
+    link.request(START, struct.pack("<II", len(image), crc))
+    width = len(str(len(image)))
+
+    def progress(done):
+        sys.stdout.write(f"\r{done:{width}}/{len(image)} bytes")
+        sys.stdout.flush()
+
+    stream(link, image, block, window, progress)
+    link.request(END)
+    dt = time.monotonic() - t0
+    print(f"\n{len(image)} bytes in {dt:.1f} s ({len(image) / dt / 1024:.1f} KB/s), "
+          f"CRC {crc:08x} verified")
+    link.request(RUN)
+    print("running the new firmware")
+
+
+def combine(args):
+    boot_path, app_path = args.combine
+    with open(boot_path, "rb") as f:
+        boot = f.read()
+    with open(app_path, "rb") as f:
+        app = pad8(f.read())
+    if len(boot) > BOOTLOADER_SIZE:
+        sys.exit(f"{boot_path}: {len(boot)} bytes, {BOOTLOADER_SIZE} fit")
+    if len(app) > APP_INFO - BOOTLOADER_SIZE:
+        sys.exit(f"{app_path}: {len(app)} bytes, {APP_INFO - BOOTLOADER_SIZE} fit")
+    out = boot + b"\xff" * (BOOTLOADER_SIZE - len(boot)) + app
+    out += b"\xff" * (APP_INFO - len(out))
+    out += struct.pack("<IIII", APP_INFO_MAGIC, len(app), zlib.crc32(app), 0xFFFFFFFF)
+    with open(args.output, "wb") as f:
+        f.write(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("port", nargs="?", help="serial port of the console or SAO UART")
+    ap.add_argument("image", nargs="?", default="build/SRAL-SAO2.bin",
+                    help="application binary (default %(default)s)")
+    ap.add_argument("-b", "--baud", type=int, default=115200, help="console baud rate")
+    ap.add_argument("-s", "--speed", type=int, default=921600, help="transfer baud rate")
+    ap.add_argument("-w", "--window", type=int, help="fewer blocks in flight")
+    ap.add_argument("--no-reboot", action="store_true",
+                    help="do not send 'reboot dfu', the bootloader is already running")
+    ap.add_argument("--combine", nargs=2, metavar=("BOOTLOADER", "IMAGE"),
+                    help="write both and the image record to -o instead")
+    ap.add_argument("-o", "--output", default="build/SRAL-SAO2-full.bin")
+    args = ap.parse_args()
+
+    if args.combine:
+        combine(args)
+        return
+    if not args.port:
+        ap.error("the serial port is required")
+    try:
+        update(args)
+    except UpdateError as e:
+        sys.exit(f"\nfwupdate: {e}")
+    except KeyboardInterrupt:
+        sys.exit("\nfwupdate: interrupted, the bootloader waits for a new attempt")
+
+
+if __name__ == "__main__":
+    main()
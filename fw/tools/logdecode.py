@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Decode the SRAL-SAO2 binary log (include/log.h) against the firmware ELF.
+
+    tools/logdecode.py build/SRAL-SAO2.elf /dev/ttyUSB0 [-b 115200]
+    build/host/SRAL-SAO2-sim scenario.txt | tools/logdecode.py build/host/SRAL-SAO2-sim -
+    tools/logdecode.py build/SRAL-SAO2.elf --list
+
+Console text passes through unchanged; each record is printed on a line of
+its own with the time since the first record seen. Only the standard
+library is needed.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+SECTION = "log_fmt"
+SPEC = re.compile(r"%([-0]?\d*)([udxXc%])")
+
+
+def read_formats(path):
+    """The log_fmt section of a 32 or 64-bit little endian ELF."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[5] != 1:
+        sys.exit(f"{path}: not a little endian ELF file")
+    if elf[4] == 1:
+        shoff, = struct.unpack_from("<I", elf, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+        sh = lambda i: struct.unpack_from("<IIIIII", elf, shoff + i * shentsize)
+    else:
+        shoff, = struct.unpack_from("<Q", elf, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x3A)
+        sh = lambda i: (lambda h: (h[0], h[1], h[2], h[3], h[4], h[5]))(
+            struct.unpack_from("<IIQQQQ", elf, shoff + i * shentsize))
+    strtab = sh(shstrndx)[4]
+    for i in range(shnum):
+        name, _, _, _, offset, size = sh(i)
+        end = elf.index(b"\0", strtab + name)
+        if elf[strtab + name:end].decode() == SECTION:
+            return elf[offset:offset + size]
+    sys.exit(f"{path}: no {SECTION} section, built without LOG()?")
+
+
+def fmt_at(formats, fid):
+    if fid >= len(formats):
+        return None
+    return formats[fid:formats.index(b"\0", fid)].decode(errors="replace")
+
+
+def render(fmt, args):
+    def one(m):
+        flags, conv = m.groups()
+        if conv == "%":
+            return "%"
+        v = args.pop(0) if args else 0
+        if conv == "d" and v & 0x80000000:
+            v -= 1 << 32
+        return ("%" + flags + ("d" if conv == "u" else conv)) % v
+    return SPEC.sub(one, fmt)
+
+
+def varints(data):
+    out, v, shift = [], 0, 0
+    for b in data:
+        v |= (b & 0x7F) << shift
+        shift += 7
+        if not b & 0x80:
+            out.append(v)
+            v, shift = 0, 0
+    return out
+
+
+def cobs_decode(data):
+    out, i = bytearray(), 0
+    while i < len(data):
+        code = data[i]
+        if code == 0:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(data):
+            out.append(0)
+    return bytes(out)
+
+
+class Decoder:
+    def __init__(self, formats, out):
+        self.formats = formats
+        self.out = out
+        self.t_us = None
+        self.frame = None   # Bytes of the record being received, None in text
+        self.bol = True
+
+    def record(self, payload):
+        if payload is None or len(payload) < 3:
+            return self.line("<bad record>")
+        fid = payload[0] | payload[1] << 8
+        values = varints(payload[2:])
+        fmt = fmt_at(self.formats, fid)
+        if fmt is None or not values:
+            return self.line(f"<unknown id {fid:#x}>")
+        # The first record seen is time zero, the device sends differences
+        self.t_us = 0 if self.t_us is None else self.t_us + values[-1]
+        self.line("[%4d.%06d] %s" % (self.t_us // 1000000, self.t_us % 1000000,
+                                     render(fmt, values[:-1])))
+
+    def line(self, text):
+        self.out.write(("" if self.bol else "\n") + text + "\n")
+        self.bol = True
+
+    def feed(self, data):
+        for b in data:
+            if b == 0:
+                if self.frame is None:
+                    self.frame = bytearray()
+                else:
+                    if self.frame:
+                        self.record(cobs_decode(bytes(self.frame)))
+                        self.frame = None
+                    # An empty frame is the end of a lost record: resync
+            elif self.frame is not None:
+                self.frame.append(b)
+            else:
+                ch = chr(b)
+                self.out.write(ch)
+                self.bol = ch == "\n"
+        self.out.flush()
+
+
+def open_port(path, baud):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        import termios
+        import tty
+        tty.setraw(fd)
+        attr = termios.tcgetattr(fd)
+        speed = getattr(termios, f"B{baud}")
+        attr[4] = attr[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attr)
+    return fd
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="firmware ELF the stream came from")
+    ap.add_argument("input", nargs="?", default="-",
+                    help="serial port or capture file, - for stdin")
+    ap.add_argument("-b", "--baud", type=int, default=115200)
+    ap.add_argument("--list", action="store_true", help="list the format strings and their IDs")
+    args = ap.parse_args()
+
+    formats = read_formats(args.elf)
+    if args.list:
+        fid = 0
+        while fid < len(formats):
+            end = formats.index(b"\0", fid)
+            if end > fid:
+                print(f"{fid:#06x} {formats[fid:end].decode(errors='replace')}")
+            fid = end + 1
+        return
+
+    dec = Decoder(formats, sys.stdout)
+    fd = 0 if args.input == "-" else open_port(args.input, args.baud)
+    try:
+        while True:
+            data = os.read(fd, 256)
+            if not data:
+                break
+            dec.feed(data)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()